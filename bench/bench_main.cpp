@@ -0,0 +1,538 @@
+#include "tree_generator.h"
+#include "lingmo_pkgbuild.h"
+#include "build_scheduler.h"
+#include "build_history.h"
+#include "preflight.h"
+#include "source_stager.h"
+#include "repo_manager.h"
+#include "snapshot_manager.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <type_traits>
+#include <map>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    std::string name;
+    std::string description;
+    size_t items = 0;              // 每次迭代处理的包数量
+    std::vector<double> samples;   // 每次迭代的秒数
+    std::string skipped;           // 非空时为跳过原因
+};
+
+struct Config {
+    TreeGenerator::Options tree;
+    int iterations = 3;
+    std::filesystem::path workDir;
+    std::filesystem::path output;
+    std::filesystem::path generateOnly;
+    bool keep = false;
+};
+
+// 替代 dpkg-buildpackage：把 src 打包成一个 deb 并写出 changes，
+// 开始和结束时间写入 $LINGMO_BENCH_STAMPS，用于拆分准备、构建和收集阶段
+const char* kStubBuildpackage = R"SH(#!/bin/sh
+set -e
+name=$(sed -n '1s/ .*//p' debian/changelog)
+version=$(sed -n '1s/.*(\(.*\)).*/\1/p' debian/changelog)
+date +%s.%N > "$LINGMO_BENCH_STAMPS/$name.start"
+root=$(mktemp -d)
+mkdir -p "$root/DEBIAN" "$root/usr/share/$name"
+printf 'Package: %s\nVersion: %s\nArchitecture: all\nMaintainer: Lingmo Bench <bench@lingmo.org>\nDescription: synthetic benchmark package\n' "$name" "$version" > "$root/DEBIAN/control"
+cp -r src "$root/usr/share/$name/"
+deb="${name}_${version}_all.deb"
+dpkg-deb -Zgzip -z1 --root-owner-group -b "$root" "../$deb" >/dev/null
+rm -rf "$root"
+{
+    printf 'Source: %s\nVersion: %s\nFiles:\n' "$name" "$version"
+    printf ' 0 %s misc optional %s\n' "$(stat -c %s "../$deb")" "$deb"
+    for orig in ../"$name"_*.orig.tar.xz; do
+        [ -e "$orig" ] && printf ' 0 %s misc optional %s\n' "$(stat -c %s "$orig")" "${orig#../}"
+    done
+} > "../${name}_${version}_all.changes"
+date +%s.%N > "$LINGMO_BENCH_STAMPS/$name.end"
+)SH";
+
+double seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double wallNow() {
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+double readStamp(const std::filesystem::path& file) {
+    std::ifstream in(file);
+    double value = 0;
+    in >> value;
+    return value;
+}
+
+double median(std::vector<double> values) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+std::string jsonString(const std::string& value) {
+    std::ostringstream out;
+    out << '"';
+    for (char c : value) {
+        switch (c) {
+        case '"': out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+            } else {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+std::string captureLine(const std::string& cmd) {
+    std::string line;
+    if (FILE* pipe = popen(cmd.c_str(), "r")) {
+        char buffer[256];
+        if (fgets(buffer, sizeof(buffer), pipe)) line = buffer;
+        pclose(pipe);
+    }
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+    return line;
+}
+
+bool haveCommand(const std::string& name) {
+    return std::system(("command -v " + name + " >/dev/null 2>&1").c_str()) == 0;
+}
+
+std::string toJson(const Config& config, const std::vector<Result>& results) {
+    char timestamp[32];
+    std::time_t now = std::time(nullptr);
+    std::tm tm{};
+    gmtime_r(&now, &tm);
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &tm);
+
+    std::ostringstream out;
+    out << std::setprecision(6) << std::fixed;
+    out << "{\n"
+        << "  \"timestamp\": " << jsonString(timestamp) << ",\n"
+        << "  \"commit\": " << jsonString(captureLine("git rev-parse HEAD 2>/dev/null")) << ",\n"
+        << "  \"cpus\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"config\": {\n"
+        << "    \"packages\": " << config.tree.packages << ",\n"
+        << "    \"files_per_package\": " << config.tree.filesPerPackage << ",\n"
+        << "    \"file_size\": " << config.tree.fileSize << ",\n"
+        << "    \"quilt_percent\": " << config.tree.quiltPercent << ",\n"
+        << "    \"max_depends\": " << config.tree.maxDepends << ",\n"
+        << "    \"seed\": " << config.tree.seed << ",\n"
+        << "    \"iterations\": " << config.iterations << "\n"
+        << "  },\n"
+        << "  \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        out << (i ? "," : "") << "\n    {\n"
+            << "      \"name\": " << jsonString(result.name) << ",\n"
+            << "      \"description\": " << jsonString(result.description) << ",\n";
+        if (!result.skipped.empty()) {
+            out << "      \"skipped\": " << jsonString(result.skipped) << "\n    }";
+            continue;
+        }
+
+        double mid = median(result.samples);
+        double mean = std::accumulate(result.samples.begin(), result.samples.end(), 0.0)
+                    / std::max<size_t>(1, result.samples.size());
+        out << "      \"items\": " << result.items << ",\n"
+            << "      \"samples\": " << result.samples.size() << ",\n"
+            << "      \"min_seconds\": " << *std::min_element(result.samples.begin(), result.samples.end()) << ",\n"
+            << "      \"median_seconds\": " << mid << ",\n"
+            << "      \"mean_seconds\": " << mean << ",\n"
+            << "      \"max_seconds\": " << *std::max_element(result.samples.begin(), result.samples.end()) << ",\n"
+            << "      \"median_ms_per_item\": " << (result.items ? mid * 1000 / result.items : 0) << "\n"
+            << "    }";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " [options]\n\n"
+              << "Generates a synthetic source tree and measures parsing, staging, the build\n"
+              << "pipeline (with a stub dpkg-buildpackage), artifact collection and repository\n"
+              << "publishing. Results are written as JSON.\n\n"
+              << "Options:\n"
+              << "  --packages <N>       Number of packages (default: 20)\n"
+              << "  --files <N>          Upstream files per package (default: 50)\n"
+              << "  --file-size <bytes>  Size of each upstream file (default: 4096)\n"
+              << "  --quilt-percent <P>  Percentage of quilt packages (default: 50)\n"
+              << "  --max-depends <N>    Maximum in-tree build dependencies per package (default: 2)\n"
+              << "  --seed <N>           Random seed of the generator (default: 1)\n"
+              << "  --iterations <N>     Samples per benchmark (default: 3)\n"
+              << "  --work-dir <dir>     Scratch directory (default: a new directory in /tmp)\n"
+              << "  --keep               Keep the scratch directory\n"
+              << "  --output <file>      Write JSON to a file instead of standard output\n"
+              << "  --generate-only <dir> Only generate the source tree into <dir>\n";
+}
+
+bool parseArgs(int argc, char* argv[], Config& config) {
+    auto number = [&](int& i, auto& target) {
+        if (i + 1 >= argc) return false;
+        try {
+            long value = std::stol(argv[++i]);
+            if (value < 0) return false;
+            target = static_cast<std::remove_reference_t<decltype(target)>>(value);
+            return true;
+        } catch (const std::exception&) {
+            return false;
+        }
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool ok = true;
+        if (arg == "--packages") ok = number(i, config.tree.packages);
+        else if (arg == "--files") ok = number(i, config.tree.filesPerPackage);
+        else if (arg == "--file-size") ok = number(i, config.tree.fileSize);
+        else if (arg == "--quilt-percent") ok = number(i, config.tree.quiltPercent);
+        else if (arg == "--max-depends") ok = number(i, config.tree.maxDepends);
+        else if (arg == "--seed") ok = number(i, config.tree.seed);
+        else if (arg == "--iterations") ok = number(i, config.iterations) && config.iterations > 0;
+        else if (arg == "--keep") config.keep = true;
+        else if ((arg == "--work-dir" || arg == "--output" || arg == "--generate-only") && i + 1 < argc) {
+            auto& target = arg == "--work-dir" ? config.workDir
+                         : arg == "--output" ? config.output : config.generateOnly;
+            target = argv[++i];
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cerr << "Invalid argument: " << arg << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+class BenchmarkSuite {
+public:
+    BenchmarkSuite(const Config& config, const std::filesystem::path& workDir)
+        : m_config(config), m_workDir(workDir),
+          m_buildDir(workDir / "build"), m_outputDir(workDir / "output"),
+          m_stampDir(workDir / "stamps") {}
+
+    std::vector<Result> run() {
+        setupStub();
+        benchGenerate();
+        benchParse();
+        benchStage();
+        benchBuildPipeline();
+        benchImport();
+        benchPublish();
+        return m_results;
+    }
+
+private:
+    void progress(const std::string& name) {
+        std::cerr << "[bench] " << name << "\n";
+    }
+
+    void setupStub() {
+        auto binDir = m_workDir / "bin";
+        std::filesystem::create_directories(binDir);
+        std::filesystem::create_directories(m_stampDir);
+        {
+            std::ofstream stub(binDir / "dpkg-buildpackage");
+            stub << kStubBuildpackage;
+        }
+        std::filesystem::permissions(binDir / "dpkg-buildpackage", std::filesystem::perms::owner_all);
+
+        const char* path = std::getenv("PATH");
+        setenv("PATH", (binDir.string() + ":" + (path ? path : "/usr/bin:/bin")).c_str(), 1);
+        setenv("LINGMO_BENCH_STAMPS", m_stampDir.c_str(), 1);
+
+        LingmoPkgBuilder::setGlobalBuildDir(m_buildDir);
+        LingmoPkgBuilder::setGlobalOutputDir(m_outputDir);
+        LingmoPkgBuilder::setSignBuild(false);
+    }
+
+    void resetDir(const std::filesystem::path& dir) {
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+    }
+
+    std::vector<std::filesystem::path> packageDirs() const {
+        std::vector<std::filesystem::path> dirs;
+        for (const auto& package : m_packages) dirs.push_back(package.dir);
+        return dirs;
+    }
+
+    void benchGenerate() {
+        progress("generate");
+        Result result{ "generate", "write the synthetic source tree", size_t(m_config.tree.packages), {}, {} };
+        for (int i = 0; i < m_config.iterations; ++i) {
+            auto start = Clock::now();
+            m_packages = TreeGenerator::generate(m_workDir / "tree", m_config.tree);
+            result.samples.push_back(seconds(start));
+        }
+        m_results.push_back(result);
+    }
+
+    void benchParse() {
+        progress("parse");
+        auto dirs = packageDirs();
+        Result preflight{ "parse_preflight", "changelog/control/format checks of every package", dirs.size(), {}, {} };
+        Result scheduler{ "parse_scheduler", "control parsing and dependency graph construction", dirs.size(), {}, {} };
+        BuildHistory history(m_workDir / BuildHistory::kFileName);
+
+        for (int i = 0; i < m_config.iterations; ++i) {
+            auto start = Clock::now();
+            for (const auto& dir : dirs) Preflight::checkPackage(dir);
+            preflight.samples.push_back(seconds(start));
+
+            start = Clock::now();
+            BuildScheduler plan(dirs, history);
+            scheduler.samples.push_back(seconds(start));
+        }
+        m_results.push_back(preflight);
+        m_results.push_back(scheduler);
+    }
+
+    void benchStage() {
+        progress("stage");
+        Result parse{ "parse_builder", "construct builders: parse changelog, control and source format", m_packages.size(), {}, {} };
+        Result stage{ "stage", "copy the files selected for building into the build directory", m_packages.size(), {}, {} };
+        for (int i = 0; i < m_config.iterations; ++i) {
+            resetDir(m_buildDir);
+            auto start = Clock::now();
+            for (const auto& package : m_packages) {
+                LingmoPkgBuilder builder(package.dir);
+            }
+            parse.samples.push_back(seconds(start));
+
+            start = Clock::now();
+            for (const auto& package : m_packages) {
+                if (!SourceStager::stage(package.dir, m_buildDir / package.name)) {
+                    throw std::runtime_error("staging of " + package.name + " failed");
+                }
+            }
+            stage.samples.push_back(seconds(start));
+        }
+        m_results.push_back(parse);
+        m_results.push_back(stage);
+    }
+
+    void benchBuildPipeline() {
+        progress("build pipeline");
+        size_t quilt = std::count_if(m_packages.begin(), m_packages.end(),
+                                     [](const TreeGenerator::Package& p) { return p.quilt; });
+        Result total{ "build_pipeline", "buildFromDirectory with a stub dpkg-buildpackage", m_packages.size(), {}, {} };
+        Result native{ "prepare_native", "staging before dpkg-buildpackage (native packages)", m_packages.size() - quilt, {}, {} };
+        Result orig{ "prepare_quilt", "staging and orig tarball before dpkg-buildpackage (quilt packages)", quilt, {}, {} };
+        Result collect{ "artifact_collection", "copying the files listed in .changes to the output directory", m_packages.size(), {}, {} };
+
+        for (int i = 0; i < m_config.iterations; ++i) {
+            resetDir(m_buildDir);
+            resetDir(m_outputDir);
+            resetDir(m_stampDir);
+
+            double nativeSeconds = 0, quiltSeconds = 0, collectSeconds = 0;
+            auto start = Clock::now();
+            for (const auto& package : m_packages) {
+                double begin = wallNow();
+                if (!LingmoPkgBuilder::buildFromDirectory(package.dir, m_outputDir.string())) {
+                    throw std::runtime_error("build of " + package.name + " failed");
+                }
+                double end = wallNow();
+
+                double stubStart = readStamp(m_stampDir / (package.name + ".start"));
+                double stubEnd = readStamp(m_stampDir / (package.name + ".end"));
+                (package.quilt ? quiltSeconds : nativeSeconds) += stubStart - begin;
+                collectSeconds += end - stubEnd;
+            }
+            total.samples.push_back(seconds(start));
+            native.samples.push_back(nativeSeconds);
+            orig.samples.push_back(quiltSeconds);
+            collect.samples.push_back(collectSeconds);
+        }
+
+        m_results.push_back(total);
+        m_results.push_back(native);
+        m_results.push_back(orig);
+        m_results.push_back(collect);
+    }
+
+    // 基准测试的机器上通常没有签名密钥，而且签名不属于工具本身的开销
+    static void disableSigning(const std::filesystem::path& repoDir) {
+        auto file = repoDir / "conf" / "distributions";
+        std::ifstream in(file);
+        std::ostringstream kept;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, 9, "SignWith:") != 0) kept << line << "\n";
+        }
+        in.close();
+        std::ofstream(file) << kept.str();
+    }
+
+    void benchImport() {
+        progress("import");
+        Result result{ "repo_import", "reprepro import of the built debs and export", m_packages.size(), {}, {} };
+        if (!haveCommand("reprepro")) {
+            result.skipped = "reprepro not found";
+            m_results.push_back(result);
+            return;
+        }
+
+        for (int i = 0; i < m_config.iterations; ++i) {
+            auto repoDir = m_workDir / "import-repo";
+            std::filesystem::remove_all(repoDir);
+            if (!lingmo::RepoManager::initRepo(repoDir, "bench")) {
+                throw std::runtime_error("unable to initialize repository");
+            }
+            disableSigning(repoDir);
+            auto start = Clock::now();
+            if (!lingmo::RepoManager::importDebDir(repoDir, m_outputDir, "bench") ||
+                !lingmo::RepoManager::exportRepo(repoDir, "bench")) {
+                throw std::runtime_error("import failed");
+            }
+            result.samples.push_back(seconds(start));
+        }
+        m_results.push_back(result);
+    }
+
+    // 与 --publish 和 lingmo-repotool --publish 相同的发布路径：reprepro export 到新快照，
+    // 生成 Contents、压缩索引、by-hash 和 Release，链接 pool 并切换 dists
+    void benchPublish() {
+        progress("publish");
+        Result result{ "repo_publish", "snapshot publish of the imported repository (export, indexes, Release, pool links)",
+                       m_packages.size(), {}, {} };
+        auto repoDir = m_workDir / "import-repo";
+        if (!haveCommand("reprepro")) {
+            result.skipped = "reprepro not found";
+            m_results.push_back(result);
+            return;
+        }
+
+        for (int i = 0; i < m_config.iterations; ++i) {
+            auto start = Clock::now();
+            if (!lingmo::SnapshotManager::publish(repoDir, "bench")) {
+                throw std::runtime_error("publishing failed");
+            }
+            result.samples.push_back(seconds(start));
+        }
+        m_results.push_back(result);
+    }
+
+    const Config& m_config;
+    std::filesystem::path m_workDir;
+    std::filesystem::path m_buildDir;
+    std::filesystem::path m_outputDir;
+    std::filesystem::path m_stampDir;
+    std::vector<TreeGenerator::Package> m_packages;
+    std::vector<Result> m_results;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Config config;
+    if (argc > 1 && (std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0)) {
+        printUsage(argv[0]);
+        return 0;
+    }
+    if (!parseArgs(argc, argv, config)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    try {
+        if (!config.generateOnly.empty()) {
+            auto packages = TreeGenerator::generate(config.generateOnly, config.tree);
+            std::cerr << "Generated " << packages.size() << " packages in " << config.generateOnly << "\n";
+            return 0;
+        }
+
+        bool ownWorkDir = config.workDir.empty();
+        if (ownWorkDir) {
+            std::string pattern = (std::filesystem::temp_directory_path() / "lingmo-bench-XXXXXX").string();
+            if (!mkdtemp(pattern.data())) {
+                std::cerr << "Unable to create a scratch directory\n";
+                return 1;
+            }
+            config.workDir = pattern;
+        }
+        auto workDir = std::filesystem::absolute(config.workDir);
+        std::filesystem::create_directories(workDir);
+
+        // 构建器和外部命令的输出写入日志，标准输出只保留 JSON
+        std::cout.flush();
+        int jsonFd = dup(STDOUT_FILENO);
+        int logFd = open((workDir / "bench.log").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (jsonFd < 0 || logFd < 0) {
+            std::cerr << "Unable to redirect output\n";
+            return 1;
+        }
+        dup2(logFd, STDOUT_FILENO);
+        close(logFd);
+
+        std::vector<Result> results;
+        bool success = true;
+        try {
+            BenchmarkSuite suite(config, workDir);
+            results = suite.run();
+        } catch (const std::exception& e) {
+            std::cerr << "Benchmark failed: " << e.what() << " (see " << (workDir / "bench.log") << ")\n";
+            success = false;
+        }
+
+        std::cout.flush();
+        dup2(jsonFd, STDOUT_FILENO);
+        close(jsonFd);
+
+        if (success) {
+            std::string json = toJson(config, results);
+            if (config.output.empty()) {
+                std::cout << json;
+            } else {
+                std::ofstream out(config.output);
+                out << json;
+                if (!out) {
+                    std::cerr << "Unable to write " << config.output << "\n";
+                    success = false;
+                } else {
+                    std::cerr << "Results written to " << config.output << "\n";
+                }
+            }
+        }
+
+        if (ownWorkDir && !config.keep && success) {
+            std::filesystem::remove_all(workDir);
+        }
+        return success ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,118 @@
+#include "tree_generator.h"
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+
+std::string packageName(int index) {
+    std::ostringstream name;
+    name << "bench-pkg" << std::setw(4) << std::setfill('0') << index;
+    return name.str();
+}
+
+// 生成可打印的伪随机内容，避免压缩率失真
+std::string randomContent(std::mt19937& rng, size_t size) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789 _;{}()\n";
+    std::uniform_int_distribution<size_t> pick(0, sizeof(alphabet) - 2);
+    std::string content(size, ' ');
+    for (auto& c : content) {
+        c = alphabet[pick(rng)];
+    }
+    return content;
+}
+
+} // namespace
+
+void TreeGenerator::writeFile(const std::filesystem::path& file, const std::string& content) {
+    std::filesystem::create_directories(file.parent_path());
+    std::ofstream out(file, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("unable to write " + file.string());
+    }
+    out << content;
+}
+
+void TreeGenerator::writeDebian(const Package& package, const std::string& version) {
+    auto debian = package.dir / "debian";
+
+    writeFile(debian / "changelog",
+        package.name + " (" + version + ") unstable; urgency=medium\n\n"
+        "  * Synthetic benchmark package.\n\n"
+        " -- Lingmo Bench <bench@lingmo.org>  Thu, 01 Jan 2026 00:00:00 +0000\n");
+
+    std::string buildDepends = "debhelper-compat (= 13)";
+    for (const auto& dep : package.buildDepends) {
+        buildDepends += ", " + dep;
+    }
+    writeFile(debian / "control",
+        "Source: " + package.name + "\n"
+        "Section: misc\n"
+        "Priority: optional\n"
+        "Maintainer: Lingmo Bench <bench@lingmo.org>\n"
+        "Build-Depends: " + buildDepends + "\n"
+        "Standards-Version: 4.6.2\n\n"
+        "Package: " + package.name + "\n"
+        "Architecture: all\n"
+        "Description: synthetic benchmark package\n"
+        " Generated by lingmo-bench.\n");
+
+    writeFile(debian / "rules", "#!/usr/bin/make -f\n%:\n\tdh $@\n");
+    std::filesystem::permissions(debian / "rules", std::filesystem::perms::owner_exec,
+                                 std::filesystem::perm_options::add);
+
+    writeFile(debian / "source" / "format", package.quilt ? "3.0 (quilt)\n" : "3.0 (native)\n");
+
+    if (package.quilt) {
+        writeFile(debian / "patches" / "series", "0001-bench.patch\n");
+        writeFile(debian / "patches" / "0001-bench.patch",
+            "--- /dev/null\n"
+            "+++ b/PATCHED\n"
+            "@@ -0,0 +1 @@\n"
+            "+patched\n");
+    }
+}
+
+std::vector<TreeGenerator::Package> TreeGenerator::generate(const std::filesystem::path& root,
+                                                            const Options& options) {
+    std::mt19937 rng(options.seed);
+    std::uniform_int_distribution<int> percent(0, 99);
+
+    std::vector<Package> packages;
+    for (int i = 0; i < options.packages; ++i) {
+        Package package;
+        package.name = packageName(i);
+        package.dir = root / package.name;
+        package.quilt = percent(rng) < options.quiltPercent;
+
+        // 只依赖编号更小的包，保证依赖图无环
+        if (i > 0 && options.maxDepends > 0) {
+            std::uniform_int_distribution<int> count(0, options.maxDepends);
+            std::uniform_int_distribution<int> target(0, i - 1);
+            for (int n = count(rng); n > 0; --n) {
+                auto dep = packageName(target(rng));
+                bool seen = false;
+                for (const auto& existing : package.buildDepends) {
+                    seen = seen || existing == dep;
+                }
+                if (!seen) package.buildDepends.push_back(dep);
+            }
+        }
+
+        std::filesystem::remove_all(package.dir);
+        writeDebian(package, package.quilt ? "1.0-1" : "1.0");
+
+        // 每个子目录放 10 个文件，模拟常见的源码目录结构
+        for (int f = 0; f < options.filesPerPackage; ++f) {
+            std::ostringstream file;
+            file << "src/dir" << std::setw(3) << std::setfill('0') << f / 10
+                 << "/file" << std::setw(4) << std::setfill('0') << f << ".c";
+            writeFile(package.dir / file.str(), randomContent(rng, options.fileSize));
+        }
+
+        packages.push_back(std::move(package));
+    }
+    return packages;
+}
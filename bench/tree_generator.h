@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <filesystem>
+
+// 为基准测试生成合成源码树：包数量、文件数量和大小、native/quilt 比例
+// 以及树内构建依赖图都可以配置，相同的种子总是生成相同的树
+class TreeGenerator {
+public:
+    struct Options {
+        int packages = 20;
+        int filesPerPackage = 50;
+        size_t fileSize = 4096;   // 每个上游文件的字节数
+        int quiltPercent = 50;    // quilt 格式包所占的百分比
+        int maxDepends = 2;       // 每个包最多依赖的树内包数量
+        unsigned seed = 1;
+    };
+
+    struct Package {
+        std::string name;
+        std::filesystem::path dir;
+        bool quilt = false;
+        std::vector<std::string> buildDepends;  // 树内构建依赖
+    };
+
+    // 在 root 下生成所有包，root 中已有的同名目录会被覆盖
+    static std::vector<Package> generate(const std::filesystem::path& root, const Options& options);
+
+private:
+    static void writeFile(const std::filesystem::path& file, const std::string& content);
+    static void writeDebian(const Package& package, const std::string& version);
+};
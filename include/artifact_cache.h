@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <filesystem>
+
+// 内容寻址的构建产物缓存，位置可以是本地（或共享挂载的）目录，也可以是支持
+// GET/PUT 的 HTTP 服务。每个缓存项保存在 <前两位>/<键>/ 下，MANIFEST 最后写入，
+// 记录每个文件的 SHA256 和大小
+class ArtifactCache {
+public:
+    explicit ArtifactCache(const std::string& location);
+
+    // 由源码哈希、构建依赖的版本、主机架构和构建选项计算缓存键。root 为空时取宿主机
+    // 已安装的版本，否则取该根目录（隔离构建的基础根目录）中 apt 列表的候选版本。
+    // 树内依赖可能由本次构建的产物提供，treeOutputs 为它们的包名到产物内容哈希
+    static std::string computeKey(const std::string& sourceHash,
+                                  const std::vector<std::string>& buildDepends,
+                                  const std::string& options,
+                                  const std::map<std::string, std::string>& treeOutputs,
+                                  const std::filesystem::path& root = {});
+
+    // 命中时把产物取到 outputDir 并校验，返回其中的 changes 文件
+    bool fetch(const std::string& key,
+               const std::filesystem::path& outputDir,
+               std::filesystem::path& changesFile) const;
+
+    // 把 changes 文件及其列出的所有文件存入缓存
+    bool store(const std::string& key, const std::filesystem::path& changesFile) const;
+
+private:
+    bool isRemote() const;
+    std::string entryPath(const std::string& key) const;
+
+    bool download(const std::string& key, const std::string& name, const std::filesystem::path& target) const;
+    bool upload(const std::string& key, const std::filesystem::path& file) const;
+
+    std::string m_location;
+};
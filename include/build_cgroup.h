@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <filesystem>
+#include "build_history.h"
+
+// 每个构建独占一个 cgroup v2 子组：限制内存和 CPU 权重，并在构建结束后
+// 读取 CPU 时间、峰值内存、I/O 字节数和 PSI 停顿时间
+class BuildCgroup {
+public:
+    // 在当前进程所在的 cgroup 下启用 memory、cpu、io 控制器。
+    // memoryMaxMb 和 cpuWeight 为 0 表示不限制；不支持 cgroup v2 时返回 false
+    static bool setup(long memoryMaxMb, int cpuWeight);
+
+    static bool enabled() { return !s_parent.empty(); }
+
+    // 为名为 name 的构建创建子 cgroup，失败时 valid() 返回 false
+    explicit BuildCgroup(const std::string& name);
+
+    // 结束仍残留在 cgroup 中的进程并删除 cgroup
+    ~BuildCgroup();
+
+    BuildCgroup(const BuildCgroup&) = delete;
+    BuildCgroup& operator=(const BuildCgroup&) = delete;
+
+    bool valid() const { return !m_path.empty(); }
+
+    // 子进程在 exec 前把 "0" 写入此文件即可加入该 cgroup
+    std::filesystem::path procsFile() const { return m_path / "cgroup.procs"; }
+
+    // 用 cgroup 的统计数据补充 usage
+    void collect(BuildUsage& usage) const;
+
+private:
+    std::filesystem::path m_path;
+
+    static std::filesystem::path s_parent;
+    static long s_memoryMaxMb;
+    static int s_cpuWeight;
+};
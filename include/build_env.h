@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <filesystem>
+
+// 隔离构建环境：每个包在基础根目录之上的一次性 overlayfs 上层中构建。
+// 通过 user/mount/pid 命名空间挂载，不需要宿主机 root 权限，构建结束后只需删除上层目录
+class IsolatedBuildEnv {
+public:
+    // baseRoot 为预先准备好的根目录（包含 build-essential 和最新的 apt 列表），
+    // buildDir 会以相同的绝对路径挂载到环境中；localRepo 中已构建的包作为额外的 apt 源，
+    // 使树内的构建依赖也能安装
+    IsolatedBuildEnv(const std::filesystem::path& baseRoot,
+                     const std::filesystem::path& buildDir,
+                     const std::filesystem::path& localRepo);
+
+    // 生成在名为 name 的新环境中执行 cmd 的命令
+    std::string wrap(const std::string& name, const std::string& cmd) const;
+
+    // 把环境中新下载的包放回共享的 apt 缓存，然后丢弃环境的上层目录
+    void discard(const std::string& name) const;
+
+    // 检查基础根目录是否可用
+    static bool validateBaseRoot(const std::filesystem::path& baseRoot);
+
+    // 在构建目录中跨构建保留的 apt 软件包缓存，各环境只读取其中的硬链接
+    static constexpr const char* kAptCacheDir = "apt-cache";
+
+private:
+    std::filesystem::path envDir(const std::string& name) const;
+
+    std::filesystem::path m_baseRoot;
+    std::filesystem::path m_buildDir;
+    std::filesystem::path m_localRepo;
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <future>
+#include <functional>
+#include <cstdint>
+#include <filesystem>
+#include "build_history.h"
+
+// 一次构建依次经过的阶段
+enum class BuildPhase {
+    Stage,        // 复制源码到构建目录
+    OrigTarball,  // 为 quilt 包生成 orig 源码包
+    Build,        // 运行 dpkg-buildpackage（隔离时包括安装构建依赖）
+    Sign,         // 在宿主机上用 debsign 签名
+    Collect,      // 把产物复制到输出目录
+    Assemble      // --binary-only 时直接组装 deb
+};
+
+const char* buildPhaseName(BuildPhase phase);
+
+// 构建过程中发送给回调的事件，回调在构建线程中调用
+struct BuildEvent {
+    enum class Type {
+        PhaseStarted,
+        PhaseFinished,
+        Log,       // 构建命令输出的一行，不含换行符
+        Artifact   // 写入输出目录的一个文件
+    };
+
+    Type type = Type::Log;
+    std::string package;
+    BuildPhase phase = BuildPhase::Stage;
+    bool success = true;            // 仅 PhaseFinished 有效
+    std::string line;               // 仅 Log 有效
+    std::filesystem::path artifact; // 仅 Artifact 有效
+};
+
+using BuildEventHandler = std::function<void(const BuildEvent&)>;
+
+struct BuildResult {
+    bool success = false;
+    bool cancelled = false;
+    BuildUsage usage;                           // dpkg-buildpackage 的资源占用
+    std::filesystem::path changesFile;          // 输出目录中的 changes 文件，没有时为空
+    std::vector<std::filesystem::path> artifacts;
+    size_t stagedFiles = 0;                     // 暂存到构建目录的文件数
+    std::uintmax_t stagedBytes = 0;
+};
+
+// 构建与句柄共享的取消状态
+struct BuildControl {
+    std::atomic<bool> cancelled{false};
+    std::atomic<long> processGroup{0};  // 正在运行的命令所在的进程组
+
+    // 设置取消标志并终止正在运行的命令
+    void cancel();
+};
+
+// LingmoPkgBuilder::start 返回的句柄，可复制，在任意线程中使用。
+// 销毁最后一个句柄时会等待构建结束
+class BuildHandle {
+public:
+    BuildHandle() = default;
+    BuildHandle(std::shared_ptr<BuildControl> control, std::shared_future<BuildResult> result)
+        : m_control(std::move(control)), m_result(std::move(result)) {}
+
+    bool valid() const { return m_result.valid(); }
+
+    // 构建是否已经结束，不阻塞
+    bool ready() const {
+        return m_result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // 阻塞直到构建结束
+    const BuildResult& wait() const { return m_result.get(); }
+
+    // 请求取消：未开始的阶段不再执行，正在运行的命令收到 SIGTERM
+    void cancel() const {
+        if (m_control) m_control->cancel();
+    }
+
+    std::shared_future<BuildResult> future() const { return m_result; }
+
+private:
+    std::shared_ptr<BuildControl> m_control;
+    std::shared_future<BuildResult> m_result;
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <filesystem>
+
+// 构建资源占用记录
+struct BuildUsage {
+    double wallSeconds = 0;   // 实际耗时
+    double cpuSeconds = 0;    // 用户态 + 内核态 CPU 时间
+    long peakRssKb = 0;       // 峰值内存
+
+    // 以下字段来自构建所在的 cgroup，只在启用 cgroup 时有效，不写入历史记录
+    bool hasCgroupStats = false;
+    std::uint64_t ioReadBytes = 0;
+    std::uint64_t ioWriteBytes = 0;
+    double cpuStallSeconds = 0;      // PSI some 累计停顿时间
+    double memoryStallSeconds = 0;
+    double ioStallSeconds = 0;
+    bool oomKilled = false;
+};
+
+// 记录每个包的历史构建耗时和内存，保存在构建目录中的追加式文本数据库
+class BuildHistory {
+public:
+    explicit BuildHistory(const std::filesystem::path& file);
+
+    // 追加一条记录并立即写入磁盘，可在多个构建线程中调用
+    void record(const std::string& package, const BuildUsage& usage, bool success);
+
+    // 根据最近几次成功构建估算资源占用，没有记录时返回 false
+    bool estimate(const std::string& package, BuildUsage& usage) const;
+
+    static constexpr const char* kFileName = "build-history.tsv";
+
+private:
+    std::filesystem::path m_file;
+    std::map<std::string, std::vector<BuildUsage>> m_samples;
+    mutable std::mutex m_mutex;
+
+    static constexpr size_t kSamples = 5;  // 参与估算的最近记录数
+};
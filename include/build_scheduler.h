@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <filesystem>
+#include "build_history.h"
+
+// 根据源码树内的构建依赖和历史耗时，按关键路径优先的顺序并行调度构建
+class BuildScheduler {
+public:
+    struct Package {
+        std::string name;                  // 源码包名，无法解析时使用目录名
+        std::filesystem::path dir;
+        std::vector<std::string> binaries; // 该源码包生成的二进制包
+        std::vector<std::string> buildDepends;  // 所有构建依赖的包名
+        std::vector<size_t> dependencies;  // 树内构建依赖
+        std::vector<size_t> dependents;
+        BuildUsage estimate;               // 预测的耗时和内存
+        bool hasHistory = false;
+        double priority = 0;               // 从该包开始的关键路径长度
+    };
+
+    BuildScheduler(const std::vector<std::filesystem::path>& packageDirs, const BuildHistory& history);
+
+    // 模拟调度并打印预测的开始时间、结束时间和总耗时
+    void printPlan(int workers, long memoryLimitKb) const;
+
+    // 并行执行构建；依赖完成后才启动，内存预测之和不超过 memoryLimitKb
+    bool run(int workers, long memoryLimitKb, const std::function<bool(const Package&)>& build);
+
+    const std::vector<Package>& packages() const { return m_packages; }
+
+    // 读取 /proc/meminfo 中的物理内存总量
+    static long systemMemoryKb();
+
+private:
+    static void parseControl(Package& package, std::vector<std::string>& buildDepends);
+
+    // 去掉有环的依赖边后计算关键路径长度
+    void resolveDependencies(const std::vector<std::vector<std::string>>& buildDepends);
+    void computePriorities();
+
+    // 选出下一个要启动的就绪包，没有合适的包时返回 -1
+    int pickNext(const std::vector<size_t>& ready, long memoryInUse, long memoryLimitKb, bool idle) const;
+
+    std::vector<Package> m_packages;
+
+    static constexpr double kDefaultWallSeconds = 60;  // 无历史且无参照时的默认耗时
+};
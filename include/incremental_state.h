@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <map>
+#include <vector>
+#include <filesystem>
+
+// 增量构建状态：记录每个包的源码哈希、产物的规范化内容哈希，以及构建时所依赖的
+// 树内包的产物哈希。依赖重新构建但产物内容不变时，下游包无需重新构建（early cutoff）
+class IncrementalState {
+public:
+    IncrementalState(const std::filesystem::path& buildDir, const std::filesystem::path& outputDir);
+
+    // 源码、依赖产物均未变化且上次的产物仍在输出目录中时返回 true
+    bool upToDate(const std::string& package,
+                  const std::vector<std::string>& dependencies,
+                  const std::string& sourceHash) const;
+
+    // 源码目录中所有文件内容的哈希，失败时返回空字符串
+    static std::string hashSource(const std::filesystem::path& sourceDir);
+
+    // 构建成功后记录新的状态
+    bool record(const std::string& package,
+                const std::string& sourceHash,
+                const std::vector<std::string>& dependencies,
+                const std::filesystem::path& changesFile) const;
+
+    // 上次记录的产物内容哈希，没有记录时返回空字符串
+    std::string outputHash(const std::string& package) const;
+
+    static constexpr const char* kDirName = "incremental";
+
+private:
+    struct State {
+        std::string source;
+        std::string output;
+        std::map<std::string, std::string> dependencies;  // 依赖包 -> 构建时的产物哈希
+        std::vector<std::string> artifacts;               // 输出目录中的文件名
+    };
+
+    bool load(const std::string& package, State& state) const;
+    bool save(const std::string& package, const State& state) const;
+
+    // 下游构建可见内容的哈希：去掉 Version 等字段的 control、维护脚本和
+    // usr/share/doc 以外的文件，因此只改动 changelog 或文档时哈希不变
+    bool hashOutput(const std::string& package,
+                    const std::vector<std::filesystem::path>& debs,
+                    std::string& hash) const;
+
+    std::filesystem::path m_stateDir;
+    std::filesystem::path m_outputDir;
+};
@@ -1,6 +1,15 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <utility>
 #include <filesystem>
+#include <functional>
+#include "build_history.h"
+#include "incremental_state.h"
+#include "build_env.h"
+#include "build_handle.h"
+#include "source_stager.h"
+#include "source_cache.h"
 
 class LingmoPkgBuilder {
 public:
@@ -9,60 +18,149 @@ public:
         Quilt     // 带补丁的包
     };
 
-    // 只保留一个构造函数，用于从源目录构建
+    enum class Compression {
+        Xz,
+        Zstd
+    };
+
+    // 单次构建的全部设置，静态 set* 方法修改的是默认设置
+    struct Options {
+        std::filesystem::path buildDir = ".build_deb_lingmo";
+        std::filesystem::path outputDir = "pkg_out";
+        int threads = 1;               // dpkg-buildpackage -j
+        bool sign = true;
+        std::string signKey;           // 为空时使用默认密钥
+        bool binaryOnly = false;
+        Compression compression = Compression::Xz;
+        std::filesystem::path isolatedRoot;
+        bool sourceCache = true;       // debian/ 和 orig 未变化时复用上次的源码包
+    };
+
+    // 异步构建请求，onEvent 为空时构建命令的输出直接写到标准输出
+    struct Request {
+        std::filesystem::path sourceDir;
+        Options options = defaultOptions();
+        BuildEventHandler onEvent;
+    };
+
+    // 使用默认设置从源目录构建
     LingmoPkgBuilder(const std::filesystem::path& sourceDir, PackageType type = PackageType::Native);
+    LingmoPkgBuilder(const std::filesystem::path& sourceDir, const Options& options,
+                     PackageType type = PackageType::Native);
 
+    // 在新线程中开始构建并立即返回句柄。不同请求之间不共享状态，
+    // 只要输出目录不同，或构建目录中的包名不冲突，就可以同时进行任意多个构建
+    static BuildHandle start(Request request);
+
+    // 同步构建，outputPath 为空时使用默认输出目录。
+    // usage 不为空时返回 dpkg-buildpackage 的耗时和峰值内存，
+    // changesFile 不为空时返回输出目录中本次构建的 changes 文件
     static bool buildFromDirectory(const std::filesystem::path& sourceDir, 
-                                 const std::string& outputPath);
+                                 const std::string& outputPath,
+                                 BuildUsage* usage = nullptr,
+                                 std::filesystem::path* changesFile = nullptr);
 
     void setMaintainer(const std::string& maintainer);
     void setDescription(const std::string& description);
     void addFile(const std::string& sourcePath, const std::string& destPath);
     bool build(const std::filesystem::path& sourceDir);
 
+    static const Options& defaultOptions() {
+        return s_defaults;
+    }
+
     static void setGlobalBuildDir(const std::filesystem::path& buildDir) {
-        s_buildDir = buildDir;
+        s_defaults.buildDir = buildDir;
     }
     
     static void setGlobalOutputDir(const std::filesystem::path& outputDir) {
-        s_outputDir = outputDir;
+        s_defaults.outputDir = outputDir;
     }
 
     // 添加设置并行构建数的静态方法
     static void setThreadCount(int threads) {
-        s_threadCount = threads;
+        s_defaults.threads = threads;
     }
 
     // 添加签名相关的设置
     static void setSignBuild(bool sign) {
-        s_signBuild = sign;
+        s_defaults.sign = sign;
     }
     
     static void setSignKey(const std::string& key) {
-        s_signKey = key;
+        s_defaults.signKey = key;
+    }
+
+    // 只把 debian/<包名> 或 debian/tmp 中已安装好的目录树打包，不运行 debian/rules
+    static void setBinaryOnly(bool binaryOnly) {
+        s_defaults.binaryOnly = binaryOnly;
+    }
+
+    // 在 baseRoot 之上的一次性 overlay 环境中安装构建依赖并构建，为空时直接在宿主机上构建
+    static void setIsolatedRoot(const std::filesystem::path& baseRoot) {
+        s_defaults.isolatedRoot = baseRoot;
+    }
+
+    static void setSourceCache(bool enabled) {
+        s_defaults.sourceCache = enabled;
+    }
+
+    // 设置 deb 中 control.tar 和 data.tar 的压缩格式
+    static void setCompression(Compression compression) {
+        s_defaults.compression = compression;
+    }
+
+    // 设置构建成功后处理 changes 文件的回调（例如发布到仓库）
+    static void setChangesHandler(std::function<void(const std::filesystem::path&)> handler) {
+        s_changesHandler = std::move(handler);
     }
 
     // 添加检查构建依赖的静态方法
     static bool checkBuildDependencies(const std::filesystem::path& sourceDir);
 
-    // 添加清理构建目录的静态方法
+    // 添加清理构建目录的静态方法，保留构建历史记录、增量构建状态、源码包缓存和 apt 缓存
     static void cleanBuildDir() {
-        if (std::filesystem::exists(s_buildDir)) {
-            std::filesystem::remove_all(s_buildDir);
+        if (!std::filesystem::exists(s_defaults.buildDir)) return;
+        for (const auto& entry : std::filesystem::directory_iterator(s_defaults.buildDir)) {
+            auto name = entry.path().filename();
+            if (name != BuildHistory::kFileName && name != IncrementalState::kDirName &&
+                name != SourceCache::kDirName && name != IsolatedBuildEnv::kAptCacheDir) {
+                std::filesystem::remove_all(entry.path());
+            }
         }
     }
 
 private:
+    // 以下三步在 m_debDir 中生成 deb 的成员，再由 writeDebFile 组装为 ar 容器
     bool createControlFile();
     bool createDataArchive();
     bool createDebianBinary();
+    bool writeDebFile(const std::filesystem::path& debFile) const;
+    bool buildBinaryOnly(const std::filesystem::path& sourceDir);
+    bool createTarArchive(const std::filesystem::path& root, const std::string& member,
+                          const std::string& exclude = "") const;
     bool createOrigTarball() const;
     bool isNativePackage() const { return m_packageType == PackageType::Native; }
 
     bool parseControlFile(const std::filesystem::path& controlFile);
     bool parseChangelogFile(const std::filesystem::path& changelogFile);
     bool copyDebianFiles(const std::filesystem::path& debianDir);
-    bool copyArtifacts(const std::string& packageName) const;
+    bool copyArtifacts(const std::string& packageName);
+    // 二进制构建完成后，用已有的源码包和 debian/files 重新生成包含两者的 changes 文件
+    bool generateChanges(const std::filesystem::path& workDir) const;
+    // 在 dir 中查找本次构建的 changes 文件
+    std::filesystem::path findChangesFile(const std::filesystem::path& dir) const;
+
+    // 发送事件，包名由构建器填写
+    void emit(BuildEvent event) const;
+    // 执行一个阶段并发送开始和结束事件，已取消时不再执行
+    bool runPhase(BuildPhase phase, const std::function<bool()>& step);
+    bool cancelled() const { return m_control && m_control->cancelled; }
+    // 记录写入输出目录的文件
+    void addArtifact(const std::filesystem::path& file);
+
+    // 执行请求，start 和 buildFromDirectory 共用
+    static BuildResult execute(const Request& request, const std::shared_ptr<BuildControl>& control);
 
     std::string m_packageName;
     std::string m_version;
@@ -70,14 +168,28 @@ private:
     std::string m_maintainer;
     std::string m_description;
     std::filesystem::path m_tempDir;
+    std::filesystem::path m_binaryRoot;  // 要打包的安装目录树
+    std::filesystem::path m_debDir;      // deb 成员的暂存目录
+    std::vector<std::pair<std::string, std::string>> m_controlFields;  // 其余 control 字段
+    long m_sourceDateEpoch = 0;          // 归档中所有文件使用的时间戳
+    BuildUsage m_usage;  // 最近一次 dpkg-buildpackage 的资源占用
+    SourceStager::Stats m_staged;
+    Options m_options;
+    BuildEventHandler m_onEvent;
+    std::shared_ptr<BuildControl> m_control;
+    std::vector<std::filesystem::path> m_artifacts;
 
     PackageType m_packageType;
 
-    static std::filesystem::path s_buildDir;
-    static std::filesystem::path s_outputDir;
-    static int s_threadCount;  // 存储并行构建数
-    static bool s_signBuild;         // 是否签名
-    static std::string s_signKey;    // 签名密钥
+    static Options s_defaults;
+    static std::function<void(const std::filesystem::path&)> s_changesHandler;
 
     static bool runCommand(const std::string& cmd);  // 用于执行命令并检查结果
+    // 执行命令并统计资源占用，cgroupProcs 不为空时子进程先加入该 cgroup。
+    // 设置了事件回调时逐行转发命令输出，可取消时命令在独立的进程组中运行
+    bool runMeasured(const std::string& cmd, BuildUsage& usage,
+                     const std::filesystem::path& cgroupProcs = {}) const;
+    // 构建过程中的其他命令（暂存、orig、打包、签名等）也经由 runMeasured 执行，
+    // 输出同样作为日志事件转发，并且能被 cancel() 结束
+    bool runStep(const std::string& cmd) const;
 }; 
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <filesystem>
+
+// 构建前并行检查所有包的 changelog、control、source/format 和补丁列表，
+// 在安装构建依赖和开始构建之前一次报告全部问题
+class Preflight {
+public:
+    struct Issue {
+        std::filesystem::path package;
+        std::string message;
+        bool error;  // false 表示只是警告
+    };
+
+    // 检查所有包并打印问题，存在错误时返回 false。
+    // binaryOnly 时不生成源码包，跳过源码格式、补丁和上游文件的检查
+    static bool run(const std::vector<std::filesystem::path>& packageDirs, bool binaryOnly = false);
+
+    // 检查单个包
+    static std::vector<Issue> checkPackage(const std::filesystem::path& packageDir, bool binaryOnly = false);
+};
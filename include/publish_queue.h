@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <filesystem>
+
+// 构建成功的包立即交给后台线程导入仓库，与后续构建并行进行
+class PublishQueue {
+public:
+    PublishQueue(const std::filesystem::path& repoDir, const std::string& codename);
+    ~PublishQueue();
+
+    PublishQueue(const PublishQueue&) = delete;
+    PublishQueue& operator=(const PublishQueue&) = delete;
+
+    // 加入一个待导入的 changes 文件
+    void enqueue(const std::filesystem::path& changesFile);
+
+    // 等待队列清空并停止后台线程，返回是否全部发布成功
+    bool finish();
+
+private:
+    void run();
+
+    std::filesystem::path m_repoDir;
+    std::string m_codename;
+
+    std::deque<std::filesystem::path> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stopping = false;
+    bool m_success = true;
+    std::thread m_worker;
+};
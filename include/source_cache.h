@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <filesystem>
+
+// 源码包缓存：debian/ 和 orig 源码包都没有变化时，复用上次 dpkg-source 生成的
+// .dsc 和 debian.tar.* 等文件，只需构建二进制包。缓存位于构建目录的
+// source-cache/<源码包>/<键>/ 下，每个源码包只保留最近一次的结果
+class SourceCache {
+public:
+    explicit SourceCache(const std::filesystem::path& buildDir);
+
+    // 由暂存目录中 debian/ 的内容、orig 源码包和构建选项计算缓存键。
+    // 原生包没有 orig，使用整个源码树的哈希。失败时返回空字符串
+    static std::string computeKey(const std::filesystem::path& sourceDir,
+                                  const std::filesystem::path& origTarball,
+                                  const std::string& options);
+
+    // 命中时把 dsc 及其列出的文件 (orig 除外) 复制到 dscFile 所在目录并校验 SHA256
+    bool fetch(const std::string& source, const std::string& key, const std::filesystem::path& dscFile) const;
+
+    // 保存 dscFile 及其列出的、orig 以外的文件，并删除该源码包较早的缓存项
+    bool store(const std::string& source, const std::string& key, const std::filesystem::path& dscFile) const;
+
+    static constexpr const char* kDirName = "source-cache";
+
+private:
+    std::filesystem::path m_dir;
+};
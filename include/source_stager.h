@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+// 决定源码目录中哪些文件参与构建：git 工作树中只取已跟踪的文件，
+// 否则遍历目录并跳过版本控制元数据；两种情况都再应用 .pkgbuildignore
+class SourceStager {
+public:
+    struct Stats {
+        size_t files = 0;
+        std::uintmax_t bytes = 0;
+        bool fromGit = false;
+    };
+
+    // 返回要暂存的条目（相对路径，按字节序排序），包括文件、符号链接和空目录
+    static std::vector<std::filesystem::path> listFiles(const std::filesystem::path& sourceDir,
+                                                        bool* fromGit = nullptr);
+
+    // 把 listFiles 列出的条目复制到 destDir
+    static bool stage(const std::filesystem::path& sourceDir,
+                      const std::filesystem::path& destDir,
+                      Stats* stats = nullptr);
+
+    static constexpr const char* kIgnoreFile = ".pkgbuildignore";
+
+private:
+    struct Pattern {
+        std::string glob;
+        bool anchored = false;       // 含有 '/' 时相对包根目录匹配整个路径，否则只匹配文件名
+        bool directoryOnly = false;  // 以 '/' 结尾时只匹配目录
+    };
+
+    static std::vector<Pattern> readIgnoreFile(const std::filesystem::path& sourceDir);
+    static bool matches(const std::vector<Pattern>& patterns, const std::string& path, bool isDirectory);
+    // 路径本身或其任一上级目录被忽略时返回 true
+    static bool ignored(const std::vector<Pattern>& patterns, const std::string& path, bool isDirectory);
+
+    static bool listGitFiles(const std::filesystem::path& sourceDir, std::vector<std::string>& files);
+};
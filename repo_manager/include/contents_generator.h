@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace lingmo {
+
+class ContentsGenerator {
+public:
+    // 为 <distsDir>/<codename> 中每个组件和架构并行生成 Contents-<arch>
+    static bool generate(const std::filesystem::path& repoDir,
+                         const std::filesystem::path& distsDir,
+                         const std::string& codename);
+
+private:
+    // 读取 deb 的文件列表：优先使用缓存，否则流式解压 data.tar 并写入缓存
+    static bool fileList(const std::filesystem::path& repoDir,
+                         const std::string& poolFile,
+                         std::vector<std::string>& files);
+
+    // 不解包到磁盘，直接通过管道列出 data.tar.{xz,zst,gz} 中的文件
+    static bool scanDeb(const std::filesystem::path& debFile, std::vector<std::string>& files);
+
+    static bool writeContents(const std::filesystem::path& repoDir,
+                              const std::filesystem::path& packagesFile,
+                              const std::filesystem::path& contentsFile);
+
+    static std::filesystem::path cachePath(const std::filesystem::path& repoDir,
+                                           const std::string& poolFile);
+};
+
+} // namespace lingmo
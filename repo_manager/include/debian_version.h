@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+
+namespace lingmo {
+
+class DebianVersion {
+public:
+    // 按 Debian 策略比较版本号 ([epoch:]upstream[-revision])
+    // 返回负数、0、正数分别表示 a < b、a == b、a > b
+    static int compare(const std::string& a, const std::string& b);
+
+private:
+    static void split(const std::string& version, long& epoch,
+                      std::string& upstream, std::string& revision);
+
+    // 比较 upstream 或 revision 部分，交替比较非数字段和数字段
+    static int compareFragment(const std::string& a, const std::string& b);
+
+    // 字符排序权重：~ 最小，其次为结尾，字母小于非字母
+    static int order(int c);
+};
+
+} // namespace lingmo
@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <filesystem>
+
+namespace lingmo {
+
+// 监视 incoming 目录，把批处理窗口内到达的 .changes 合并为一次导入和一次导出
+class IncomingDaemon {
+public:
+    static bool run(const std::filesystem::path& repoDir,
+                    const std::filesystem::path& incomingDir,
+                    const std::string& codename,
+                    int batchSeconds = 10);
+
+private:
+    enum class Validation {
+        Complete,     // 所有文件就绪且校验和匹配
+        Incomplete,   // 仍有文件未上传完
+        Invalid       // 校验和不匹配或格式错误
+    };
+
+    // 检查 .changes 中列出的文件是否齐全，并核对大小和 SHA256
+    static Validation validateChanges(const std::filesystem::path& changesFile,
+                                      std::vector<std::filesystem::path>& files,
+                                      std::string& reason);
+
+    // 在单写者锁内导入整批 changes，最后统一导出一次
+    static void processBatch(const std::filesystem::path& repoDir,
+                             const std::filesystem::path& incomingDir,
+                             const std::string& codename,
+                             std::map<std::filesystem::path, std::chrono::steady_clock::time_point>& pending);
+
+    // 把无法导入的上传移到 rejected/ 并记录原因
+    static void reject(const std::filesystem::path& incomingDir,
+                       const std::filesystem::path& changesFile,
+                       const std::vector<std::filesystem::path>& files,
+                       const std::string& reason);
+
+    // 上传不完整时最多等待的时间
+    static constexpr std::chrono::minutes kIncompleteTimeout{30};
+};
+
+} // namespace lingmo
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <filesystem>
+
+namespace lingmo {
+
+// 进程内的 Prometheus 指标，按文本格式写出供 node_exporter 的 textfile 收集器读取。
+// 未设置输出文件时所有记录操作直接返回
+class Metrics {
+public:
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+    // 设置输出文件（应以 .prom 结尾），为空时关闭指标
+    static void setOutputFile(const std::filesystem::path& file);
+    static bool enabled();
+
+    // 声明指标的类型 (gauge 或 counter) 和说明
+    static void describe(const std::string& name, const std::string& type, const std::string& help);
+
+    static void set(const std::string& name, const Labels& labels, double value);
+    static void add(const std::string& name, const Labels& labels, double delta);
+
+    // 写入临时文件后 rename，收集器不会读到写了一半的文件。可在多个线程中调用
+    static bool write();
+};
+
+} // namespace lingmo
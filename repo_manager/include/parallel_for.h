@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lingmo {
+
+// 用不超过 CPU 核数的线程对 0..count-1 并行执行 task，第一个异常在全部线程结束后重新抛出。
+// 仓库工具和构建工具共用，任务数量再多也不会创建过多线程
+inline void parallelFor(size_t count, const std::function<void(size_t)>& task) {
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < workers && i < count; ++i) {
+        threads.emplace_back([&]() {
+            for (size_t idx = next++; idx < count; idx = next++) {
+                try {
+                    task(idx);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) error = std::current_exception();
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    if (error) std::rethrow_exception(error);
+}
+
+} // namespace lingmo
@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+namespace lingmo {
+
+// 为 Packages/Sources 生成 Packages.diff/Index 和 ed 格式补丁，
+// 客户端只需下载自上次更新以来的增量
+class PDiffGenerator {
+public:
+    // 处理 <distsDir>/<codename> 下的所有 Packages 和 Sources
+    static bool generate(const std::filesystem::path& repoDir,
+                         const std::filesystem::path& distsDir,
+                         const std::string& codename);
+
+    // generate 的新状态先写入 *.pending，索引真正发布后 published 为 true 时提交，
+    // 否则丢弃，补丁链始终与客户端看到的索引一致
+    static void finish(const std::filesystem::path& repoDir, const std::string& codename, bool published);
+
+    // 读取 conf/lingmo-repotool 中的 PDiffDepth，0 表示不生成补丁
+    static int historyDepth(const std::filesystem::path& repoDir);
+
+private:
+    struct Patch {
+        std::string name;           // 补丁名，如 2024-02-19-1400.00
+        std::string historySha256;  // 补丁所基于的旧索引
+        std::uintmax_t historySize = 0;
+        std::string patchSha256;    // 未压缩补丁
+        std::uintmax_t patchSize = 0;
+        std::string downloadSha256; // 压缩后的补丁
+        std::uintmax_t downloadSize = 0;
+    };
+
+    // 为单个索引生成补丁，状态保存在 stateDir 中
+    static bool generateForIndex(const std::filesystem::path& index,
+                                 const std::filesystem::path& stateDir,
+                                 int depth);
+
+    static std::vector<Patch> readHistory(const std::filesystem::path& historyFile);
+    static bool writeHistory(const std::filesystem::path& historyFile, const std::vector<Patch>& patches);
+
+    // 写出 <index>.diff/Index 并链接补丁文件
+    static bool writeIndex(const std::filesystem::path& index,
+                           const std::string& currentSha256,
+                           const std::filesystem::path& patchDir,
+                           const std::vector<Patch>& patches);
+
+    static constexpr int kDefaultDepth = 14;
+    static constexpr const char* kPreviousPending = "previous.pending";
+    static constexpr const char* kHistoryPending = "history.pending";
+};
+
+} // namespace lingmo
@@ -0,0 +1,22 @@
+#pragma once
+#include <filesystem>
+
+namespace lingmo {
+
+// 仓库单写者锁：对 db/lingmo-repotool.lock 加 flock，析构时释放
+// 同一进程内不要嵌套获取，否则会自我阻塞
+class RepoLock {
+public:
+    explicit RepoLock(const std::filesystem::path& repoDir);
+    ~RepoLock();
+
+    RepoLock(const RepoLock&) = delete;
+    RepoLock& operator=(const RepoLock&) = delete;
+
+    bool locked() const { return m_fd >= 0; }
+
+private:
+    int m_fd = -1;
+};
+
+} // namespace lingmo
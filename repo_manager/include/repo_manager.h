@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <vector>
 #include <filesystem>
 
 namespace lingmo {
@@ -9,6 +10,16 @@ public:
     // 初始化仓库
     static bool initRepo(const std::filesystem::path& repoDir, const std::string& codename);
 
+    // 初始化包含多个发行版和组件的仓库，已存在的发行版配置保持不变
+    static bool initRepo(const std::filesystem::path& repoDir,
+                         const std::vector<std::string>& codenames,
+                         const std::vector<std::string>& components);
+
+    // 在新快照中导出索引，发布压缩格式、by-hash 副本和 Release 后原子切换
+    static bool exportRepo(const std::filesystem::path& repoDir, const std::string& codename);
+
+    // 导入操作不会导出索引，导入完成后需调用 exportRepo
+
     // 导入单个 changes 文件
     static bool importChanges(const std::filesystem::path& repoDir, 
                             const std::filesystem::path& changesFile,
@@ -31,10 +42,39 @@ public:
                            const std::string& codename,
                            const std::string& component = "main");
 
+    // 每个软件包在发行版中只保留最新的 keep 个版本，并删除不再被引用的 pool 文件
+    static bool garbageCollect(const std::filesystem::path& repoDir,
+                               const std::string& codename,
+                               int keep);
+
+    // 把软件包引用从 from 复制到 to，复用 pool 文件，只重新生成 to 的索引
+    // packages 中的每一项为 "name" 或 "name=version"
+    static bool promote(const std::filesystem::path& repoDir,
+                        const std::string& from,
+                        const std::string& to,
+                        const std::vector<std::string>& packages);
+
+    // 按源码包提升，同时复制源码包及其生成的所有二进制包
+    static bool promoteSource(const std::filesystem::path& repoDir,
+                              const std::string& from,
+                              const std::string& to,
+                              const std::string& source,
+                              const std::string& version = "");
+
+    // 声明仓库相关指标的类型和说明
+    static void describeMetrics();
+
+    // 记录 pool 的文件数、字节数和快照数量，未启用指标时不做任何事
+    static void recordSizeMetrics(const std::filesystem::path& repoDir);
+
 private:
-    // 创建仓库配置文件
+    // 创建仓库配置文件，追加尚未配置的发行版
     static bool createRepoConfig(const std::filesystem::path& repoDir, 
-                               const std::string& codename);
+                               const std::vector<std::string>& codenames,
+                               const std::vector<std::string>& components);
+
+    // 为没有 Limit 的发行版补上 Limit: 0，使 reprepro 保留所有版本
+    static bool ensureVersionLimit(const std::filesystem::path& repoDir);
 
     // 检查 reprepro 是否可用
     static bool checkReprepro();
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+namespace lingmo {
+
+class RepoPublisher {
+public:
+    // 发布导出到 distsDir（快照目录）中的 <codename>：生成 Contents，并行生成压缩索引、
+    // by-hash 副本并重写 Release。repoDir/dists 是指向正在服务的快照的链接，
+    // 不能在其中原地发布，应通过 SnapshotManager::publish 调用
+    static bool publish(const std::filesystem::path& repoDir,
+                        const std::filesystem::path& distsDir,
+                        const std::string& codename);
+
+private:
+    struct IndexEntry {
+        std::filesystem::path path;   // 相对于发行版目录的路径
+        std::string md5;
+        std::string sha256;
+        std::uintmax_t size = 0;
+    };
+
+    // 查找需要压缩的未压缩索引文件 (Packages, Sources, Contents-<arch>)
+    static std::vector<std::filesystem::path> findIndexFiles(const std::filesystem::path& distDir);
+
+    // 每种压缩格式使用独立线程压缩同一索引
+    static bool compressIndexes(const std::vector<std::filesystem::path>& indexes);
+
+    // 计算发行版目录下所有需列入 Release 的文件摘要
+    static std::vector<IndexEntry> collectEntries(const std::filesystem::path& distDir);
+
+    // 将索引以哈希命名链接到 by-hash 目录，并清理过旧的副本
+    static bool writeByHash(const std::filesystem::path& distDir,
+                            const std::vector<IndexEntry>& entries);
+
+    // 原子地重写 Release，并在配置了 SignWith 时重新签名
+    static bool writeRelease(const std::filesystem::path& repoDir,
+                             const std::filesystem::path& distDir,
+                             const std::string& codename,
+                             const std::vector<IndexEntry>& entries);
+
+    static bool signRelease(const std::filesystem::path& repoDir,
+                            const std::filesystem::path& distDir,
+                            const std::string& codename);
+
+    // 每个 by-hash 目录中保留的历史副本数量
+    static constexpr size_t kByHashHistory = 16;
+};
+
+} // namespace lingmo
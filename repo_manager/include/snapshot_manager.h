@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <filesystem>
+
+namespace lingmo {
+
+// 仓库快照：每次发布都在 snapshots/<name>/ 下生成完整的 dists 树，
+// pool 通过硬链接共享，最后原子地把 dists 符号链接切换到新快照
+class SnapshotManager {
+public:
+    // 在新快照中导出并发布 codename，name 为空时自动命名
+    static bool publish(const std::filesystem::path& repoDir,
+                        const std::string& codename,
+                        const std::string& name = "");
+
+    // 回滚到指定快照：恢复 pool 文件和快照中保存的 reprepro 数据库，再切换 dists
+    static bool rollback(const std::filesystem::path& repoDir, const std::string& name);
+
+    // 列出所有快照，标记当前正在服务的快照
+    static bool list(const std::filesystem::path& repoDir);
+
+private:
+    // publish 的实际实现，publish 在外层记录耗时和结果
+    static bool publishSnapshot(const std::filesystem::path& repoDir,
+                                const std::string& codename,
+                                const std::string& name);
+
+    // 当前 dists 符号链接指向的快照名，没有时返回空
+    static std::string liveSnapshot(const std::filesystem::path& repoDir);
+
+    // 用硬链接复制目录树，跳过 skip 子目录
+    static void linkTree(const std::filesystem::path& from,
+                         const std::filesystem::path& to,
+                         const std::filesystem::path& skip = {});
+
+    // 为快照中所有索引引用的 pool 文件创建硬链接
+    static bool linkPool(const std::filesystem::path& repoDir,
+                         const std::filesystem::path& snapshotDir);
+
+    // 复制 reprepro 数据库文件（不含子目录中的缓存）。cloneOnly 时只在文件系统支持
+    // reflink 时以共享数据块的方式克隆，不支持时不复制并返回 false
+    static bool copyDatabase(const std::filesystem::path& from, const std::filesystem::path& to,
+                             bool cloneOnly = false);
+
+    // 原子地把 repoDir/dists 切换为指向快照的符号链接
+    static bool switchTo(const std::filesystem::path& repoDir, const std::string& name);
+
+    // 只保留最近的若干个自动快照，命名快照永久保留
+    static void pruneAutomatic(const std::filesystem::path& repoDir);
+
+    static constexpr size_t kKeepAutomatic = 5;
+};
+
+} // namespace lingmo
@@ -0,0 +1,221 @@
+#include "contents_generator.h"
+#include "repo_utils.h"
+#include "parallel_for.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+namespace lingmo {
+
+namespace {
+
+struct ContentsJob {
+    std::filesystem::path packagesFile;
+    std::filesystem::path contentsFile;
+};
+
+// 根据 data.tar 的压缩格式选择解压命令
+std::string decompressorFor(const std::string& member) {
+    if (member == "data.tar.xz") return "xz -dc";
+    if (member == "data.tar.zst") return "zstd -dc";
+    if (member == "data.tar.gz") return "gzip -dc";
+    if (member == "data.tar.bz2") return "bzip2 -dc";
+    if (member == "data.tar") return "cat";
+    return "";
+}
+
+} // namespace
+
+std::filesystem::path ContentsGenerator::cachePath(const std::filesystem::path& repoDir,
+                                                   const std::string& poolFile) {
+    // pool 中的文件名包含版本号且不会被覆盖，可以直接作为缓存键
+    return repoDir / "db" / "contents" / (poolFile + ".list");
+}
+
+bool ContentsGenerator::scanDeb(const std::filesystem::path& debFile, std::vector<std::string>& files) {
+    std::string members;
+    if (!detail::captureCommand("ar t " + detail::shellQuote(debFile), members)) {
+        return false;
+    }
+
+    std::string dataMember;
+    std::istringstream memberStream(members);
+    std::string member;
+    while (std::getline(memberStream, member)) {
+        if (member.compare(0, 8, "data.tar") == 0) {
+            dataMember = member;
+            break;
+        }
+    }
+
+    std::string decompressor = decompressorFor(dataMember);
+    if (decompressor.empty()) {
+        std::cerr << _("Error: Unsupported data archive in") << " " << debFile << "\n";
+        return false;
+    }
+
+    std::string listing;
+    // pipefail 使 ar 或解压失败时整条管道失败，而不是得到不完整的列表
+    std::string pipeline = "ar p " + detail::shellQuote(debFile) + " " + dataMember
+                         + " | " + decompressor + " | tar -t";
+    std::string cmd = "bash -o pipefail -c " + detail::shellQuote(pipeline);
+    if (!detail::captureCommand(cmd, listing)) {
+        return false;
+    }
+
+    std::istringstream listStream(listing);
+    std::string path;
+    while (std::getline(listStream, path)) {
+        // Contents 只记录非目录条目，路径不带前导 ./
+        if (path.empty() || path.back() == '/') continue;
+        if (path.compare(0, 2, "./") == 0) path.erase(0, 2);
+        if (!path.empty()) files.push_back(path);
+    }
+    return true;
+}
+
+bool ContentsGenerator::fileList(const std::filesystem::path& repoDir,
+                                 const std::string& poolFile,
+                                 std::vector<std::string>& files) {
+    auto cache = cachePath(repoDir, poolFile);
+    std::ifstream cached(cache);
+    if (cached.is_open()) {
+        std::string line;
+        while (std::getline(cached, line)) {
+            if (!line.empty()) files.push_back(line);
+        }
+        return true;
+    }
+
+    if (!scanDeb(repoDir / poolFile, files)) {
+        std::cerr << _("Error: Failed to read file list of") << " " << poolFile << "\n";
+        return false;
+    }
+
+    std::filesystem::create_directories(cache.parent_path());
+    auto tmp = detail::uniqueTempPath(cache);
+    {
+        std::ofstream out(tmp);
+        for (const auto& file : files) {
+            out << file << "\n";
+        }
+    }
+    std::filesystem::rename(tmp, cache);
+    return true;
+}
+
+bool ContentsGenerator::writeContents(const std::filesystem::path& repoDir,
+                                      const std::filesystem::path& packagesFile,
+                                      const std::filesystem::path& contentsFile) {
+    // 路径 -> section/package 列表，std::map 保证输出按路径排序
+    std::map<std::string, std::set<std::string>> contents;
+    bool success = true;
+
+    detail::forEachStanza(packagesFile, [&](const detail::Stanza& stanza) {
+        auto package = stanza.find("Package");
+        auto filename = stanza.find("Filename");
+        if (package == stanza.end() || filename == stanza.end()) return;
+
+        auto section = stanza.find("Section");
+        std::string qualified = (section != stanza.end() ? section->second + "/" : "")
+                              + package->second;
+
+        std::vector<std::string> files;
+        if (!fileList(repoDir, filename->second, files)) {
+            success = false;
+            return;
+        }
+        for (const auto& file : files) {
+            contents[file].insert(qualified);
+        }
+    });
+
+    auto tmp = detail::uniqueTempPath(contentsFile);
+    {
+        std::ofstream out(tmp);
+        if (!out.is_open()) {
+            std::cerr << _("Error: Unable to write Contents file") << ": " << contentsFile << "\n";
+            return false;
+        }
+        for (const auto& [path, packages] : contents) {
+            out << path << std::string(path.size() < 60 ? 60 - path.size() : 1, ' ');
+            bool first = true;
+            for (const auto& pkg : packages) {
+                out << (first ? "" : ",") << pkg;
+                first = false;
+            }
+            out << "\n";
+        }
+    }
+    std::filesystem::rename(tmp, contentsFile);
+    return success;
+}
+
+bool ContentsGenerator::generate(const std::filesystem::path& repoDir,
+                                 const std::filesystem::path& distsDir,
+                                 const std::string& codename) {
+    auto distDir = distsDir / codename;
+    if (!std::filesystem::exists(distDir)) {
+        std::cerr << _("Error: Distribution has not been exported") << ": " << distDir << "\n";
+        return false;
+    }
+
+    try {
+        // 收集每个组件下的 binary-<arch>/Packages
+        std::vector<ContentsJob> jobs;
+        std::set<std::string> poolFiles;
+        for (const auto& component : std::filesystem::directory_iterator(distDir)) {
+            if (!component.is_directory() || component.path().filename() == "by-hash") continue;
+            for (const auto& archDir : std::filesystem::directory_iterator(component.path())) {
+                auto name = archDir.path().filename().string();
+                if (!archDir.is_directory() || name.compare(0, 7, "binary-") != 0) continue;
+
+                auto packages = archDir.path() / "Packages";
+                if (!std::filesystem::exists(packages)) continue;
+
+                jobs.push_back({ packages, component.path() / ("Contents-" + name.substr(7)) });
+                detail::forEachStanza(packages, [&](const detail::Stanza& stanza) {
+                    auto filename = stanza.find("Filename");
+                    if (filename != stanza.end()) poolFiles.insert(filename->second);
+                });
+            }
+        }
+
+        // 只扫描缓存中尚不存在的新导入包，多线程并行
+        std::vector<std::string> pending;
+        for (const auto& poolFile : poolFiles) {
+            if (!std::filesystem::exists(cachePath(repoDir, poolFile))) {
+                pending.push_back(poolFile);
+            }
+        }
+
+        std::atomic<bool> scanOk{true};
+        if (!pending.empty()) {
+            std::cout << _("Scanning file lists of new packages") << ": " << pending.size() << "\n";
+
+            parallelFor(pending.size(), [&repoDir, &pending, &scanOk](size_t i) {
+                std::vector<std::string> files;
+                if (!fileList(repoDir, pending[i], files)) scanOk = false;
+            });
+        }
+
+        // 各架构的 Contents 相互独立，并行写出
+        std::atomic<bool> success{scanOk.load()};
+        parallelFor(jobs.size(), [&repoDir, &jobs, &success](size_t i) {
+            if (!writeContents(repoDir, jobs[i].packagesFile, jobs[i].contentsFile)) success = false;
+        });
+        return success;
+    } catch (const std::exception& e) {
+        std::cerr << _("Error: Failed to generate Contents indexes") << ": " << e.what() << "\n";
+        return false;
+    }
+}
+
+} // namespace lingmo
@@ -0,0 +1,81 @@
+#include "debian_version.h"
+#include <cctype>
+#include <cstdlib>
+
+namespace lingmo {
+
+void DebianVersion::split(const std::string& version, long& epoch,
+                          std::string& upstream, std::string& revision) {
+    std::string rest = version;
+    epoch = 0;
+
+    auto colon = rest.find(':');
+    if (colon != std::string::npos) {
+        epoch = std::strtol(rest.substr(0, colon).c_str(), nullptr, 10);
+        rest = rest.substr(colon + 1);
+    }
+
+    auto dash = rest.rfind('-');
+    if (dash != std::string::npos) {
+        upstream = rest.substr(0, dash);
+        revision = rest.substr(dash + 1);
+    } else {
+        upstream = rest;
+        revision.clear();
+    }
+}
+
+int DebianVersion::order(int c) {
+    if (std::isdigit(c)) return 0;
+    if (std::isalpha(c)) return c;
+    if (c == '~') return -1;
+    if (c) return c + 256;
+    return 0;
+}
+
+int DebianVersion::compareFragment(const std::string& a, const std::string& b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() || j < b.size()) {
+        int firstDiff = 0;
+
+        // 非数字部分逐字符比较
+        while ((i < a.size() && !std::isdigit(static_cast<unsigned char>(a[i]))) ||
+               (j < b.size() && !std::isdigit(static_cast<unsigned char>(b[j])))) {
+            int ac = i < a.size() ? order(static_cast<unsigned char>(a[i])) : 0;
+            int bc = j < b.size() ? order(static_cast<unsigned char>(b[j])) : 0;
+            if (ac != bc) return ac - bc;
+            ++i;
+            ++j;
+        }
+
+        // 数字部分按数值比较（跳过前导零）
+        while (i < a.size() && a[i] == '0') ++i;
+        while (j < b.size() && b[j] == '0') ++j;
+        while (i < a.size() && std::isdigit(static_cast<unsigned char>(a[i])) &&
+               j < b.size() && std::isdigit(static_cast<unsigned char>(b[j]))) {
+            if (!firstDiff) firstDiff = a[i] - b[j];
+            ++i;
+            ++j;
+        }
+        if (i < a.size() && std::isdigit(static_cast<unsigned char>(a[i]))) return 1;
+        if (j < b.size() && std::isdigit(static_cast<unsigned char>(b[j]))) return -1;
+        if (firstDiff) return firstDiff;
+    }
+    return 0;
+}
+
+int DebianVersion::compare(const std::string& a, const std::string& b) {
+    long epochA, epochB;
+    std::string upstreamA, upstreamB, revisionA, revisionB;
+    split(a, epochA, upstreamA, revisionA);
+    split(b, epochB, upstreamB, revisionB);
+
+    if (epochA != epochB) return epochA < epochB ? -1 : 1;
+
+    int result = compareFragment(upstreamA, upstreamB);
+    if (result) return result;
+
+    return compareFragment(revisionA, revisionB);
+}
+
+} // namespace lingmo
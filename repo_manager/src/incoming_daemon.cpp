@@ -0,0 +1,299 @@
+#include "incoming_daemon.h"
+#include "repo_manager.h"
+#include "repo_lock.h"
+#include "repo_utils.h"
+#include "metrics.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <csignal>
+#include <cerrno>
+#include <climits>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+namespace lingmo {
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void handleStopSignal(int) {
+    g_stop = 1;
+}
+
+bool isChangesFile(const std::filesystem::path& path) {
+    return path.extension() == ".changes";
+}
+
+} // namespace
+
+IncomingDaemon::Validation IncomingDaemon::validateChanges(const std::filesystem::path& changesFile,
+                                                           std::vector<std::filesystem::path>& files,
+                                                           std::string& reason) {
+    files.clear();
+    std::string checksums;
+    bool parsed = detail::forEachStanza(changesFile, [&](const detail::Stanza& stanza) {
+        auto field = stanza.find("Checksums-Sha256");
+        if (field != stanza.end()) checksums = field->second;
+    });
+
+    if (!parsed || checksums.empty()) {
+        reason = "missing Checksums-Sha256 field";
+        return Validation::Invalid;
+    }
+
+    auto dir = changesFile.parent_path();
+    bool complete = true;
+    std::istringstream lines(checksums);
+    std::string sha256, name;
+    std::uintmax_t size = 0;
+    while (lines >> sha256 >> size >> name) {
+        if (name.find('/') != std::string::npos) {
+            reason = "invalid file name " + name;
+            return Validation::Invalid;
+        }
+
+        auto file = dir / name;
+        files.push_back(file);
+
+        std::error_code ec;
+        auto actual = std::filesystem::file_size(file, ec);
+        if (ec || actual < size) {
+            // 文件尚未到达或仍在写入
+            complete = false;
+            continue;
+        }
+        if (actual != size || detail::fileDigest("sha256sum", file) != sha256) {
+            reason = "checksum mismatch for " + name;
+            return Validation::Invalid;
+        }
+    }
+
+    if (files.empty()) {
+        reason = "no files listed";
+        return Validation::Invalid;
+    }
+    return complete ? Validation::Complete : Validation::Incomplete;
+}
+
+void IncomingDaemon::reject(const std::filesystem::path& incomingDir,
+                            const std::filesystem::path& changesFile,
+                            const std::vector<std::filesystem::path>& files,
+                            const std::string& reason) {
+    std::cerr << _("Rejecting") << " " << changesFile.filename() << ": " << reason << "\n";
+
+    auto rejectedDir = incomingDir / "rejected";
+    std::error_code ec;
+    std::filesystem::create_directories(rejectedDir, ec);
+
+    for (const auto& file : files) {
+        if (std::filesystem::exists(file)) {
+            std::filesystem::rename(file, rejectedDir / file.filename(), ec);
+        }
+    }
+    std::filesystem::rename(changesFile, rejectedDir / changesFile.filename(), ec);
+
+    std::ofstream note(rejectedDir / (changesFile.filename().string() + ".reason"));
+    note << reason << "\n";
+}
+
+void IncomingDaemon::processBatch(const std::filesystem::path& repoDir,
+                                  const std::filesystem::path& incomingDir,
+                                  const std::string& codename,
+                                  std::map<std::filesystem::path, std::chrono::steady_clock::time_point>& pending) {
+    using Upload = std::pair<std::filesystem::path, std::vector<std::filesystem::path>>;
+    std::vector<Upload> ready;
+    std::vector<std::pair<Upload, std::string>> rejected;
+    // 仍在等待其余文件的上传引用的文件，本批次中不能移动或删除
+    std::set<std::filesystem::path> waiting;
+    auto now = std::chrono::steady_clock::now();
+
+    for (auto it = pending.begin(); it != pending.end();) {
+        const auto& changesFile = it->first;
+        if (!std::filesystem::exists(changesFile)) {
+            it = pending.erase(it);
+            continue;
+        }
+
+        std::vector<std::filesystem::path> files;
+        std::string reason;
+        switch (validateChanges(changesFile, files, reason)) {
+        case Validation::Complete:
+            ready.emplace_back(changesFile, files);
+            it = pending.erase(it);
+            break;
+        case Validation::Incomplete:
+            if (now - it->second > kIncompleteTimeout) {
+                rejected.push_back({ { changesFile, files }, "upload incomplete" });
+                it = pending.erase(it);
+            } else {
+                waiting.insert(files.begin(), files.end());
+                ++it;
+            }
+            break;
+        case Validation::Invalid:
+            rejected.push_back({ { changesFile, files }, reason });
+            it = pending.erase(it);
+            break;
+        }
+    }
+
+    // 被拒绝的上传可能与其他上传共享文件 (如同名 orig)，这些文件保留给其他上传
+    auto rejectAll = [&](const std::vector<std::pair<Upload, std::string>>& uploads,
+                         const std::set<std::filesystem::path>& inUse) {
+        for (const auto& [entry, reason] : uploads) {
+            std::vector<std::filesystem::path> own;
+            for (const auto& file : entry.second) {
+                if (!inUse.count(file)) own.push_back(file);
+            }
+            reject(incomingDir, entry.first, own, reason);
+            Metrics::add("lingmo_repo_incoming_rejected_total", { { "codename", codename } }, 1);
+        }
+    };
+
+    std::set<std::filesystem::path> inUse = waiting;
+    for (const auto& [changesFile, files] : ready) {
+        inUse.insert(files.begin(), files.end());
+    }
+    rejectAll(rejected, inUse);
+
+    if (ready.empty()) return;
+
+    std::cout << _("Importing batch of") << " " << ready.size() << " " << _("uploads") << "\n";
+
+    // 整批在一次加锁内完成，与其他写入者互斥
+    RepoLock lock(repoDir);
+    if (!lock.locked()) {
+        // 放回等待队列，下一批次重试
+        for (const auto& [changesFile, files] : ready) {
+            pending.emplace(changesFile, now);
+        }
+        return;
+    }
+
+    // 同一批次的上传可能共享文件，全部导入完成后才移动或删除上传目录中的文件
+    std::vector<Upload> imported;
+    std::vector<std::pair<Upload, std::string>> failed;
+    for (const auto& upload : ready) {
+        if (RepoManager::importChanges(repoDir, upload.first, codename)) {
+            imported.push_back(upload);
+        } else {
+            failed.push_back({ upload, "reprepro include failed" });
+        }
+    }
+
+    // 已导入的上传不再需要这些文件，失败的上传连同共享文件一起移入 rejected
+    rejectAll(failed, waiting);
+
+    // reprepro 已把文件复制进 pool，上传目录中的副本可以删除，失败或仍在等待的上传引用的文件除外
+    std::set<std::filesystem::path> keep = waiting;
+    for (const auto& [upload, reason] : failed) {
+        keep.insert(upload.second.begin(), upload.second.end());
+    }
+    std::error_code ec;
+    for (const auto& [changesFile, files] : imported) {
+        for (const auto& file : files) {
+            if (!keep.count(file)) std::filesystem::remove(file, ec);
+        }
+        std::filesystem::remove(changesFile, ec);
+    }
+
+    if (!imported.empty() && !RepoManager::exportRepo(repoDir, codename)) {
+        std::cerr << _("Error: Failed to export repository") << "\n";
+    }
+}
+
+bool IncomingDaemon::run(const std::filesystem::path& repoDir,
+                         const std::filesystem::path& incomingDir,
+                         const std::string& codename,
+                         int batchSeconds) {
+    if (!std::filesystem::is_directory(incomingDir)) {
+        std::cerr << _("Error: Directory not found") << ": " << incomingDir << "\n";
+        return false;
+    }
+
+    int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0 || inotify_add_watch(fd, incomingDir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cerr << _("Error: Unable to watch incoming directory") << "\n";
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    std::signal(SIGINT, handleStopSignal);
+    std::signal(SIGTERM, handleStopSignal);
+
+    using Clock = std::chrono::steady_clock;
+    std::map<std::filesystem::path, Clock::time_point> pending;
+    Clock::time_point batchDeadline = Clock::time_point::max();
+    const auto window = std::chrono::seconds(batchSeconds);
+
+    // 启动前已经存在的上传同样需要处理
+    for (const auto& entry : std::filesystem::directory_iterator(incomingDir)) {
+        if (entry.is_regular_file() && isChangesFile(entry.path())) {
+            pending.emplace(entry.path(), Clock::now());
+        }
+    }
+    if (!pending.empty()) batchDeadline = Clock::now() + window;
+
+    // 每批处理后更新指标文件，启动时先写一次让收集器看到守护进程的初始状态
+    auto updateMetrics = [&]() {
+        if (!Metrics::enabled()) return;
+        Metrics::set("lingmo_repo_incoming_pending", { { "codename", codename } }, static_cast<double>(pending.size()));
+        RepoManager::recordSizeMetrics(repoDir);
+        Metrics::write();
+    };
+    updateMetrics();
+
+    std::cout << _("Watching incoming directory") << ": " << incomingDir << "\n";
+
+    alignas(inotify_event) char buffer[sizeof(inotify_event) + NAME_MAX + 1];
+    while (!g_stop) {
+        int timeout = -1;
+        if (batchDeadline != Clock::time_point::max()) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(batchDeadline - Clock::now());
+            timeout = remaining.count() > 0 ? static_cast<int>(remaining.count()) : 0;
+        }
+
+        pollfd pfd{ fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, timeout);
+        if (ready < 0 && errno != EINTR) break;
+
+        if (ready > 0) {
+            ssize_t len;
+            while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+                for (char* ptr = buffer; ptr < buffer + len;) {
+                    auto* event = reinterpret_cast<inotify_event*>(ptr);
+                    ptr += sizeof(inotify_event) + event->len;
+                    if (event->len == 0) continue;
+
+                    // 任何文件到达都可能让等待中的 changes 变得完整，统一延到批处理时检查
+                    auto path = incomingDir / event->name;
+                    if (isChangesFile(path)) {
+                        pending.emplace(path, Clock::now());
+                    }
+                    if (!pending.empty() && batchDeadline == Clock::time_point::max()) {
+                        batchDeadline = Clock::now() + window;
+                    }
+                }
+            }
+        }
+
+        if (Clock::now() >= batchDeadline) {
+            processBatch(repoDir, incomingDir, codename, pending);
+            batchDeadline = pending.empty() ? Clock::time_point::max() : Clock::now() + window;
+            updateMetrics();
+        }
+    }
+
+    close(fd);
+    std::cout << _("Incoming daemon stopped") << "\n";
+    return true;
+}
+
+} // namespace lingmo
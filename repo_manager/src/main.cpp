@@ -1,6 +1,14 @@
 #include "repo_manager.h"
+#include "snapshot_manager.h"
+#include "incoming_daemon.h"
+#include "repo_lock.h"
+#include "metrics.h"
 #include <iostream>
 #include <filesystem>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <ctime>
 #include <libintl.h>
 #include <locale.h>
 
@@ -8,23 +16,47 @@
 
 using namespace lingmo;
 
+// 把逗号分隔的参数拆分为列表
+std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
 void printUsage(const char* programName) {
     std::cout << _("Lingmo OS Repository Management Tool") << "\n\n"
               << _("Usage:") << "\n"
-              << "  " << programName << " --init <" << _("codename") << "> <" << _("repository directory") << ">\n"
+              << "  " << programName << " --init <" << _("codename") << "[,...]> <" << _("repository directory") << "> [" << _("component") << "[,...]]\n"
               << "  " << programName << " -c <" << _("codename") << "> <" << _("changes file/directory") << ">\n"
-              << "  " << programName << " -deb <" << _("codename") << "> <" << _("deb file/directory") << ">\n"
+              << "  " << programName << " -deb <" << _("codename") << "> <" << _("deb file/directory") << "> [" << _("component") << "]\n"
+              << "  " << programName << " --publish <" << _("codename") << ">\n"
+              << "  " << programName << " --gc <" << _("codename") << "> <" << _("versions to keep") << ">\n"
+              << "  " << programName << " --snapshot <" << _("codename") << "> <" << _("snapshot name") << ">\n"
+              << "  " << programName << " --rollback <" << _("snapshot name") << ">\n"
+              << "  " << programName << " --snapshots\n"
+              << "  " << programName << " --promote <" << _("from") << "> <" << _("to") << "> <" << _("package") << "[=" << _("version") << "]>...\n"
+              << "  " << programName << " --promote-source <" << _("from") << "> <" << _("to") << "> <" << _("source") << "> [" << _("version") << "]\n"
+              << "  " << programName << " --daemon <" << _("codename") << "> <" << _("incoming directory") << "> [" << _("batch seconds") << "]\n"
               << _("Options:") << "\n"
+              << "      --metrics-file <" << _("file") << "> " << _("Write Prometheus metrics for node_exporter's textfile collector") << "\n"
               << "      --init     " << _("Initialize a new repository") << "\n"
               << "  -c, --changes  " << _("Import changes file(s) to repository") << "\n"
-              << "  -deb           " << _("Import deb package(s) to repository") << "\n";
+              << "  -deb           " << _("Import deb package(s) to repository") << "\n"
+              << "      --publish  " << _("Export indexes with .gz/.xz/.zst and by-hash variants") << "\n"
+              << "      --gc       " << _("Prune old versions and delete unreferenced pool files") << "\n"
+              << "      --snapshot " << _("Publish into a named snapshot that is kept for rollback") << "\n"
+              << "      --rollback " << _("Switch the live repository back to a snapshot") << "\n"
+              << "      --snapshots " << _("List snapshots") << "\n"
+              << "      --promote  " << _("Copy packages between suites without re-importing") << "\n"
+              << "      --promote-source " << _("Copy a source package and its binaries between suites") << "\n"
+              << "      --daemon   " << _("Watch an incoming directory and import uploads in batches") << "\n";
 }
 
-int main(int argc, char* argv[]) {
-    setlocale(LC_ALL, "");
-    bindtextdomain("lingmo-repotool", "/usr/share/locale");
-    textdomain("lingmo-repotool");
-
+int runCommand(int argc, char* argv[]) {
     try {
         if (argc < 2) {
             printUsage(argv[0]);
@@ -35,13 +67,14 @@ int main(int argc, char* argv[]) {
         
         // 处理仓库初始化
         if (arg1 == "--init") {
-            if (argc != 4) {
+            if (argc != 4 && argc != 5) {
                 std::cerr << _("Error: --init requires codename and repository directory") << "\n";
                 return 1;
             }
-            std::string codename = argv[2];
+            auto codenames = splitList(argv[2]);
             std::filesystem::path repoDir = argv[3];
-            return RepoManager::initRepo(repoDir, codename) ? 0 : 1;
+            auto components = argc == 5 ? splitList(argv[4]) : std::vector<std::string>{ "main" };
+            return RepoManager::initRepo(repoDir, codenames, components) ? 0 : 1;
         }
 
         // 处理导入 changes 文件
@@ -60,21 +93,25 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
 
-            if (std::filesystem::is_directory(path)) {
-                return RepoManager::importChangesDir(repoDir, path, codename) ? 0 : 1;
-            } else {
-                return RepoManager::importChanges(repoDir, path, codename) ? 0 : 1;
-            }
+            RepoLock lock(repoDir);
+            if (!lock.locked()) return 1;
+
+            bool imported = std::filesystem::is_directory(path)
+                ? RepoManager::importChangesDir(repoDir, path, codename)
+                : RepoManager::importChanges(repoDir, path, codename);
+            bool published = RepoManager::exportRepo(repoDir, codename);
+            return imported && published ? 0 : 1;
         }
 
         // 处理导入 deb 包
         if (arg1 == "-deb") {
-            if (argc != 4) {
+            if (argc != 4 && argc != 5) {
                 std::cerr << _("Error: -deb requires codename and deb file/directory") << "\n";
                 return 1;
             }
             std::string codename = argv[2];
             std::filesystem::path path = argv[3];
+            std::string component = argc == 5 ? argv[4] : "main";
             
             // 自动检测当前目录是否为仓库目录
             std::filesystem::path repoDir = std::filesystem::current_path();
@@ -83,11 +120,145 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
 
-            if (std::filesystem::is_directory(path)) {
-                return RepoManager::importDebDir(repoDir, path, codename) ? 0 : 1;
-            } else {
-                return RepoManager::importDeb(repoDir, path, codename) ? 0 : 1;
+            RepoLock lock(repoDir);
+            if (!lock.locked()) return 1;
+
+            bool imported = std::filesystem::is_directory(path)
+                ? RepoManager::importDebDir(repoDir, path, codename, component)
+                : RepoManager::importDeb(repoDir, path, codename, component);
+            bool published = RepoManager::exportRepo(repoDir, codename);
+            return imported && published ? 0 : 1;
+        }
+
+        // 重新导出并发布索引
+        if (arg1 == "--publish") {
+            if (argc != 3) {
+                std::cerr << _("Error: --publish requires codename") << "\n";
+                return 1;
+            }
+            std::string codename = argv[2];
+
+            std::filesystem::path repoDir = std::filesystem::current_path();
+            if (!std::filesystem::exists(repoDir / "conf" / "distributions")) {
+                std::cerr << _("Error: Current directory is not a repository") << "\n";
+                return 1;
+            }
+
+            RepoLock lock(repoDir);
+            if (!lock.locked()) return 1;
+
+            return RepoManager::exportRepo(repoDir, codename) ? 0 : 1;
+        }
+
+        // 清理旧版本和无引用的 pool 文件
+        if (arg1 == "--gc") {
+            if (argc != 4) {
+                std::cerr << _("Error: --gc requires codename and number of versions to keep") << "\n";
+                return 1;
             }
+            std::string codename = argv[2];
+            int keep = 0;
+            try {
+                keep = std::stoi(argv[3]);
+            } catch (const std::exception&) {
+                std::cerr << _("Error: Invalid number of versions to keep") << "\n";
+                return 1;
+            }
+
+            std::filesystem::path repoDir = std::filesystem::current_path();
+            if (!std::filesystem::exists(repoDir / "conf" / "distributions")) {
+                std::cerr << _("Error: Current directory is not a repository") << "\n";
+                return 1;
+            }
+
+            RepoLock lock(repoDir);
+            if (!lock.locked()) return 1;
+
+            return RepoManager::garbageCollect(repoDir, codename, keep) ? 0 : 1;
+        }
+
+        // 快照管理
+        if (arg1 == "--snapshot" || arg1 == "--rollback" || arg1 == "--snapshots") {
+            std::filesystem::path repoDir = std::filesystem::current_path();
+            if (!std::filesystem::exists(repoDir / "conf" / "distributions")) {
+                std::cerr << _("Error: Current directory is not a repository") << "\n";
+                return 1;
+            }
+
+            if (arg1 == "--snapshots") {
+                return SnapshotManager::list(repoDir) ? 0 : 1;
+            }
+
+            RepoLock lock(repoDir);
+            if (!lock.locked()) return 1;
+
+            if (arg1 == "--rollback") {
+                if (argc != 3) {
+                    std::cerr << _("Error: --rollback requires snapshot name") << "\n";
+                    return 1;
+                }
+                return SnapshotManager::rollback(repoDir, argv[2]) ? 0 : 1;
+            }
+            if (argc != 4) {
+                std::cerr << _("Error: --snapshot requires codename and snapshot name") << "\n";
+                return 1;
+            }
+            return SnapshotManager::publish(repoDir, argv[2], argv[3]) ? 0 : 1;
+        }
+
+        // 在发行版之间提升软件包
+        if (arg1 == "--promote" || arg1 == "--promote-source") {
+            bool bySource = arg1 == "--promote-source";
+            if (argc < 5 || (bySource && argc > 6)) {
+                std::cerr << _("Error: --promote requires source suite, target suite and packages") << "\n";
+                return 1;
+            }
+            std::string from = argv[2];
+            std::string to = argv[3];
+
+            std::filesystem::path repoDir = std::filesystem::current_path();
+            if (!std::filesystem::exists(repoDir / "conf" / "distributions")) {
+                std::cerr << _("Error: Current directory is not a repository") << "\n";
+                return 1;
+            }
+
+            RepoLock lock(repoDir);
+            if (!lock.locked()) return 1;
+
+            if (bySource) {
+                return RepoManager::promoteSource(repoDir, from, to, argv[4], argc == 6 ? argv[5] : "") ? 0 : 1;
+            }
+            return RepoManager::promote(repoDir, from, to, std::vector<std::string>(argv + 4, argv + argc)) ? 0 : 1;
+        }
+
+        // 监视 incoming 目录并批量导入
+        if (arg1 == "--daemon") {
+            if (argc != 4 && argc != 5) {
+                std::cerr << _("Error: --daemon requires codename and incoming directory") << "\n";
+                return 1;
+            }
+            std::string codename = argv[2];
+            std::filesystem::path incomingDir = argv[3];
+            int batchSeconds = 10;
+            if (argc == 5) {
+                try {
+                    batchSeconds = std::stoi(argv[4]);
+                } catch (const std::exception&) {
+                    batchSeconds = -1;
+                }
+                if (batchSeconds < 0) {
+                    std::cerr << _("Error: Invalid batch window") << "\n";
+                    return 1;
+                }
+            }
+
+            std::filesystem::path repoDir = std::filesystem::current_path();
+            if (!std::filesystem::exists(repoDir / "conf" / "distributions")) {
+                std::cerr << _("Error: Current directory is not a repository") << "\n";
+                return 1;
+            }
+
+            return IncomingDaemon::run(repoDir, incomingDir, codename, batchSeconds) ? 0 : 1;
         }
 
         printUsage(argv[0]);
@@ -97,4 +268,47 @@ int main(int argc, char* argv[]) {
         std::cerr << _("Error") << ": " << e.what() << "\n";
         return 1;
     }
-} 
\ No newline at end of file
+} 
+int main(int argc, char* argv[]) {
+    setlocale(LC_ALL, "");
+    bindtextdomain("lingmo-repotool", "/usr/share/locale");
+    textdomain("lingmo-repotool");
+
+    // --metrics-file 可以出现在任意位置，先取出再解析命令
+    std::vector<char*> args;
+    for (int i = 0; i < argc; ++i) {
+        if (std::string(argv[i]) == "--metrics-file") {
+            if (i + 1 >= argc) {
+                std::cerr << _("Error: --metrics-file requires a file path") << "\n";
+                return 1;
+            }
+            Metrics::setOutputFile(argv[++i]);
+            continue;
+        }
+        args.push_back(argv[i]);
+    }
+    args.push_back(nullptr);
+
+    RepoManager::describeMetrics();
+    Metrics::describe("lingmo_repotool_run_duration_seconds", "gauge", "Duration of the last lingmo-repotool run");
+    Metrics::describe("lingmo_repotool_run_success", "gauge", "Whether the last lingmo-repotool run succeeded");
+    Metrics::describe("lingmo_repotool_last_run_timestamp_seconds", "gauge", "Unix time of the last lingmo-repotool run");
+
+    auto start = std::chrono::steady_clock::now();
+    int status = runCommand(static_cast<int>(args.size()) - 1, args.data());
+
+    if (Metrics::enabled() && args.size() > 2) {
+        Metrics::Labels labels = { { "command", args[1] } };
+        Metrics::set("lingmo_repotool_run_duration_seconds", labels,
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        Metrics::set("lingmo_repotool_run_success", labels, status == 0 ? 1 : 0);
+        Metrics::set("lingmo_repotool_last_run_timestamp_seconds", labels, static_cast<double>(std::time(nullptr)));
+
+        std::filesystem::path repoDir = std::filesystem::current_path();
+        if (std::filesystem::exists(repoDir / "conf" / "distributions")) {
+            RepoManager::recordSizeMetrics(repoDir);
+        }
+        if (!Metrics::write() && status == 0) status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,122 @@
+#include "metrics.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <unistd.h>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+namespace lingmo {
+
+namespace {
+
+struct Family {
+    std::string type;
+    std::string help;
+    std::map<std::string, double> samples;  // 格式化后的标签 -> 值
+};
+
+std::mutex g_mutex;
+std::filesystem::path g_file;
+std::map<std::string, Family> g_families;
+std::mutex g_writeMutex;  // 多个线程同时写出时避免互相覆盖临时文件
+
+std::string escapeLabel(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\') escaped += "\\\\";
+        else if (c == '"') escaped += "\\\"";
+        else if (c == '\n') escaped += "\\n";
+        else escaped += c;
+    }
+    return escaped;
+}
+
+std::string formatLabels(const Metrics::Labels& labels) {
+    if (labels.empty()) return "";
+    std::string text = "{";
+    for (size_t i = 0; i < labels.size(); ++i) {
+        text += (i ? "," : "") + labels[i].first + "=\"" + escapeLabel(labels[i].second) + "\"";
+    }
+    return text + "}";
+}
+
+} // namespace
+
+void Metrics::setOutputFile(const std::filesystem::path& file) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_file = file;
+}
+
+bool Metrics::enabled() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return !g_file.empty();
+}
+
+void Metrics::describe(const std::string& name, const std::string& type, const std::string& help) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto& family = g_families[name];
+    family.type = type;
+    family.help = help;
+}
+
+void Metrics::set(const std::string& name, const Labels& labels, double value) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_file.empty()) return;
+    g_families[name].samples[formatLabels(labels)] = value;
+}
+
+void Metrics::add(const std::string& name, const Labels& labels, double delta) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_file.empty()) return;
+    g_families[name].samples[formatLabels(labels)] += delta;
+}
+
+bool Metrics::write() {
+    std::ostringstream text;
+    std::filesystem::path file;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (g_file.empty()) return true;
+        file = g_file;
+
+        text << std::setprecision(15);
+        for (const auto& [name, family] : g_families) {
+            if (family.samples.empty()) continue;
+            if (!family.help.empty()) text << "# HELP " << name << " " << family.help << "\n";
+            if (!family.type.empty()) text << "# TYPE " << name << " " << family.type << "\n";
+            for (const auto& [labels, value] : family.samples) {
+                text << name << labels << " " << value << "\n";
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(g_writeMutex);
+    // 临时文件不以 .prom 结尾，收集器会忽略它
+    auto tmp = file.parent_path() / ("." + file.filename().string() + "." + std::to_string(getpid()) + ".tmp");
+    {
+        std::ofstream out(tmp);
+        out << text.str();
+        if (!out) {
+            std::cerr << _("Error: Unable to write metrics file") << ": " << file << "\n";
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, file, ec);
+    if (ec) {
+        std::cerr << _("Error: Unable to write metrics file") << ": " << file << "\n";
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+} // namespace lingmo
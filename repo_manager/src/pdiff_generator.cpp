@@ -0,0 +1,271 @@
+#include "pdiff_generator.h"
+#include "repo_utils.h"
+#include "parallel_for.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <algorithm>
+#include <ctime>
+#include <sys/wait.h>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+namespace lingmo {
+
+namespace {
+
+// 补丁名沿用 Debian 归档的格式，如 2024-02-19-1400.00
+std::string patchTimestamp() {
+    std::time_t now = std::time(nullptr);
+    std::tm tm{};
+    gmtime_r(&now, &tm);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d-%H%M.%S", &tm);
+    return buf;
+}
+
+void linkOrCopy(const std::filesystem::path& from, const std::filesystem::path& to) {
+    std::error_code ec;
+    std::filesystem::create_hard_link(from, to, ec);
+    if (ec) {
+        std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing);
+    }
+}
+
+} // namespace
+
+int PDiffGenerator::historyDepth(const std::filesystem::path& repoDir) {
+    int depth = kDefaultDepth;
+    detail::forEachStanza(repoDir / "conf" / "lingmo-repotool", [&](const detail::Stanza& stanza) {
+        auto field = stanza.find("PDiffDepth");
+        if (field == stanza.end()) return;
+        try {
+            depth = std::stoi(field->second);
+        } catch (const std::exception&) {
+            std::cerr << _("Warning: Invalid PDiffDepth, using default") << "\n";
+        }
+    });
+    return depth;
+}
+
+std::vector<PDiffGenerator::Patch> PDiffGenerator::readHistory(const std::filesystem::path& historyFile) {
+    std::vector<Patch> patches;
+    std::ifstream in(historyFile);
+    Patch patch;
+    while (in >> patch.name >> patch.historySha256 >> patch.historySize
+              >> patch.patchSha256 >> patch.patchSize
+              >> patch.downloadSha256 >> patch.downloadSize) {
+        patches.push_back(patch);
+    }
+    return patches;
+}
+
+bool PDiffGenerator::writeHistory(const std::filesystem::path& historyFile, const std::vector<Patch>& patches) {
+    auto tmp = historyFile;
+    tmp += ".new";
+    {
+        std::ofstream out(tmp);
+        if (!out.is_open()) return false;
+        for (const auto& patch : patches) {
+            out << patch.name << " " << patch.historySha256 << " " << patch.historySize << " "
+                << patch.patchSha256 << " " << patch.patchSize << " "
+                << patch.downloadSha256 << " " << patch.downloadSize << "\n";
+        }
+    }
+    std::filesystem::rename(tmp, historyFile);
+    return true;
+}
+
+bool PDiffGenerator::writeIndex(const std::filesystem::path& index,
+                                const std::string& currentSha256,
+                                const std::filesystem::path& patchDir,
+                                const std::vector<Patch>& patches) {
+    auto diffDir = index.parent_path() / (index.filename().string() + ".diff");
+    std::filesystem::create_directories(diffDir);
+
+    // 只保留历史记录中仍存在的补丁
+    for (const auto& entry : std::filesystem::directory_iterator(diffDir)) {
+        auto name = entry.path().filename().string();
+        if (name == "Index") continue;
+        bool referenced = std::any_of(patches.begin(), patches.end(), [&](const Patch& patch) {
+            return patch.name + ".gz" == name;
+        });
+        if (!referenced) std::filesystem::remove(entry.path());
+    }
+    for (const auto& patch : patches) {
+        auto target = diffDir / (patch.name + ".gz");
+        if (!std::filesystem::exists(target)) {
+            linkOrCopy(patchDir / (patch.name + ".gz"), target);
+        }
+    }
+
+    auto tmp = diffDir / "Index.new";
+    {
+        std::ofstream out(tmp);
+        if (!out.is_open()) return false;
+
+        out << "SHA256-Current: " << currentSha256 << " " << std::filesystem::file_size(index) << "\n";
+        out << "SHA256-History:\n";
+        for (const auto& patch : patches) {
+            out << " " << patch.historySha256 << " " << patch.historySize << " " << patch.name << "\n";
+        }
+        out << "SHA256-Patches:\n";
+        for (const auto& patch : patches) {
+            out << " " << patch.patchSha256 << " " << patch.patchSize << " " << patch.name << "\n";
+        }
+        out << "SHA256-Download:\n";
+        for (const auto& patch : patches) {
+            out << " " << patch.downloadSha256 << " " << patch.downloadSize << " " << patch.name << ".gz\n";
+        }
+    }
+    std::filesystem::rename(tmp, diffDir / "Index");
+    return true;
+}
+
+bool PDiffGenerator::generateForIndex(const std::filesystem::path& index,
+                                      const std::filesystem::path& stateDir,
+                                      int depth) {
+    auto previous = stateDir / "previous";
+    auto historyFile = stateDir / "history";
+    auto patchDir = stateDir / "patches";
+    std::filesystem::create_directories(patchDir);
+
+    auto patches = readHistory(historyFile);
+    std::string currentSha256 = detail::fileDigest("sha256sum", index);
+    if (currentSha256.empty()) return false;
+
+    if (std::filesystem::exists(previous)) {
+        std::string previousSha256 = detail::fileDigest("sha256sum", previous);
+        if (previousSha256 != currentSha256) {
+            std::string name = patchTimestamp();
+            for (int i = 1; std::any_of(patches.begin(), patches.end(),
+                                        [&](const Patch& p) { return p.name == name; }); ++i) {
+                name = patchTimestamp() + std::to_string(i);
+            }
+
+            auto patchFile = patchDir / name;
+            std::string diffCmd = "diff --ed " + detail::shellQuote(previous) + " "
+                                + detail::shellQuote(index) + " > " + detail::shellQuote(patchFile);
+            // diff 在存在差异时返回 1
+            int status = std::system(diffCmd.c_str());
+            if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) > 1) {
+                std::filesystem::remove(patchFile);
+                return false;
+            }
+
+            std::string gzipCmd = "gzip -9nc " + detail::shellQuote(patchFile) + " > "
+                                + detail::shellQuote(patchFile.string() + ".gz");
+            if (std::system(gzipCmd.c_str()) != 0) {
+                std::filesystem::remove(patchFile);
+                return false;
+            }
+
+            Patch patch;
+            patch.name = name;
+            patch.historySha256 = previousSha256;
+            patch.historySize = std::filesystem::file_size(previous);
+            patch.patchSha256 = detail::fileDigest("sha256sum", patchFile);
+            patch.patchSize = std::filesystem::file_size(patchFile);
+            patch.downloadSha256 = detail::fileDigest("sha256sum", patchFile.string() + ".gz");
+            patch.downloadSize = std::filesystem::file_size(patchFile.string() + ".gz");
+            patches.push_back(patch);
+
+            // 只保留压缩后的补丁，摘要已记录在 history 中
+            std::filesystem::remove(patchFile);
+
+            // 移出历史的补丁文件在 finish 时删除，发布失败时旧的历史仍然完整
+            while (static_cast<int>(patches.size()) > depth) {
+                patches.erase(patches.begin());
+            }
+            if (!writeHistory(stateDir / kHistoryPending, patches)) return false;
+        }
+    }
+
+    auto tmp = stateDir / kPreviousPending;
+    tmp += ".new";
+    std::filesystem::copy_file(index, tmp, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::rename(tmp, stateDir / kPreviousPending);
+
+    if (patches.empty()) return true;
+    return writeIndex(index, currentSha256, patchDir, patches);
+}
+
+bool PDiffGenerator::generate(const std::filesystem::path& repoDir,
+                              const std::filesystem::path& distsDir,
+                              const std::string& codename) {
+    int depth = historyDepth(repoDir);
+    if (depth <= 0) return true;
+
+    auto distDir = distsDir / codename;
+    try {
+        std::vector<std::filesystem::path> indexes;
+        for (auto it = std::filesystem::recursive_directory_iterator(distDir);
+             it != std::filesystem::recursive_directory_iterator(); ++it) {
+            auto name = it->path().filename().string();
+            if (it->is_directory() && (name == "by-hash" || it->path().extension() == ".diff")) {
+                it.disable_recursion_pending();
+                continue;
+            }
+            if (it->is_regular_file() && (name == "Packages" || name == "Sources")) {
+                indexes.push_back(it->path());
+            }
+        }
+
+        // 各索引的补丁相互独立，并行计算
+        std::atomic<bool> success{true};
+        parallelFor(indexes.size(), [&](size_t i) {
+            auto stateDir = repoDir / "db" / "pdiff" / codename / std::filesystem::relative(indexes[i], distDir);
+            if (!generateForIndex(indexes[i], stateDir, depth)) success = false;
+        });
+        if (!success) {
+            std::cerr << _("Error: Failed to generate index diffs") << "\n";
+        }
+        return success;
+    } catch (const std::exception& e) {
+        std::cerr << _("Error: Failed to generate index diffs") << ": " << e.what() << "\n";
+        return false;
+    }
+}
+
+void PDiffGenerator::finish(const std::filesystem::path& repoDir, const std::string& codename, bool published) {
+    auto codenameDir = repoDir / "db" / "pdiff" / codename;
+    if (!std::filesystem::exists(codenameDir)) return;
+
+    try {
+        std::vector<std::filesystem::path> stateDirs;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(codenameDir)) {
+            if (entry.path().filename() == kPreviousPending) {
+                stateDirs.push_back(entry.path().parent_path());
+            }
+        }
+
+        for (const auto& stateDir : stateDirs) {
+            auto historyPending = stateDir / kHistoryPending;
+            if (published) {
+                if (std::filesystem::exists(historyPending)) {
+                    std::filesystem::rename(historyPending, stateDir / "history");
+                }
+                std::filesystem::rename(stateDir / kPreviousPending, stateDir / "previous");
+            } else {
+                std::filesystem::remove(historyPending);
+                std::filesystem::remove(stateDir / kPreviousPending);
+            }
+
+            // 删除不在已提交历史中的补丁：发布时移出历史的旧补丁，或未发布的新补丁
+            auto patches = readHistory(stateDir / "history");
+            for (const auto& entry : std::filesystem::directory_iterator(stateDir / "patches")) {
+                auto name = entry.path().filename().string();
+                bool referenced = std::any_of(patches.begin(), patches.end(), [&](const Patch& patch) {
+                    return patch.name + ".gz" == name;
+                });
+                if (!referenced) std::filesystem::remove(entry.path());
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << _("Error: Failed to generate index diffs") << ": " << e.what() << "\n";
+    }
+}
+
+} // namespace lingmo
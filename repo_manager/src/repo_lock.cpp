@@ -0,0 +1,44 @@
+#include "repo_lock.h"
+#include <iostream>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+namespace lingmo {
+
+RepoLock::RepoLock(const std::filesystem::path& repoDir) {
+    auto dbDir = repoDir / "db";
+    std::error_code ec;
+    std::filesystem::create_directories(dbDir, ec);
+
+    m_fd = ::open((dbDir / "lingmo-repotool.lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        std::cerr << _("Error: Unable to open repository lock") << "\n";
+        return;
+    }
+
+    if (::flock(m_fd, LOCK_EX | LOCK_NB) != 0) {
+        std::cout << _("Waiting for repository lock...") << "\n";
+        while (::flock(m_fd, LOCK_EX) != 0) {
+            if (errno != EINTR) {
+                std::cerr << _("Error: Unable to lock repository") << "\n";
+                ::close(m_fd);
+                m_fd = -1;
+                return;
+            }
+        }
+    }
+}
+
+RepoLock::~RepoLock() {
+    if (m_fd >= 0) {
+        ::flock(m_fd, LOCK_UN);
+        ::close(m_fd);
+    }
+}
+
+} // namespace lingmo
@@ -1,6 +1,15 @@
 #include "repo_manager.h"
+#include "snapshot_manager.h"
+#include "debian_version.h"
+#include "repo_utils.h"
+#include "metrics.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <tuple>
+#include <algorithm>
 #include <cstdlib>
 #include <libintl.h>
 
@@ -8,8 +17,57 @@
 
 namespace lingmo {
 
+namespace {
+
+void recordImport(const std::string& codename, const std::string& kind, bool success) {
+    Metrics::add("lingmo_repo_imports_total",
+                 { { "codename", codename }, { "kind", kind }, { "result", success ? "success" : "failure" } }, 1);
+}
+
+} // namespace
+
 bool RepoManager::s_repreproChecked = false;
 
+void RepoManager::describeMetrics() {
+    Metrics::describe("lingmo_repo_imports_total", "counter", "Uploads imported into the repository by this run");
+    Metrics::describe("lingmo_repo_publish_duration_seconds", "gauge", "Duration of the last index export and publish");
+    Metrics::describe("lingmo_repo_publish_success", "gauge", "Whether the last publish succeeded");
+    Metrics::describe("lingmo_repo_last_publish_timestamp_seconds", "gauge", "Unix time of the last publish");
+    Metrics::describe("lingmo_repo_pool_bytes", "gauge", "Total size of the files in pool/");
+    Metrics::describe("lingmo_repo_pool_files", "gauge", "Number of files in pool/");
+    Metrics::describe("lingmo_repo_snapshots", "gauge", "Number of published snapshots");
+    Metrics::describe("lingmo_repo_incoming_pending", "gauge", "Uploads waiting in the incoming directory");
+    Metrics::describe("lingmo_repo_incoming_rejected_total", "counter", "Uploads rejected by the incoming daemon");
+}
+
+void RepoManager::recordSizeMetrics(const std::filesystem::path& repoDir) {
+    if (!Metrics::enabled()) return;
+
+    std::uintmax_t bytes = 0;
+    size_t files = 0;
+    std::error_code ec;
+    if (std::filesystem::exists(repoDir / "pool")) {
+        for (auto it = std::filesystem::recursive_directory_iterator(repoDir / "pool", ec);
+             !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_regular_file(ec)) {
+                bytes += it->file_size(ec);
+                ++files;
+            }
+        }
+    }
+
+    size_t snapshots = 0;
+    if (std::filesystem::exists(repoDir / "snapshots")) {
+        for (const auto& entry : std::filesystem::directory_iterator(repoDir / "snapshots", ec)) {
+            if (entry.is_directory()) ++snapshots;
+        }
+    }
+
+    Metrics::set("lingmo_repo_pool_bytes", {}, static_cast<double>(bytes));
+    Metrics::set("lingmo_repo_pool_files", {}, static_cast<double>(files));
+    Metrics::set("lingmo_repo_snapshots", {}, static_cast<double>(snapshots));
+}
+
 bool RepoManager::checkReprepro() {
     if (s_repreproChecked) return true;
     
@@ -28,46 +86,147 @@ bool RepoManager::runRepreproCommand(const std::string& cmd) {
 }
 
 bool RepoManager::createRepoConfig(const std::filesystem::path& repoDir, 
-                                 const std::string& codename) {
+                                 const std::vector<std::string>& codenames,
+                                 const std::vector<std::string>& components) {
     auto confDir = repoDir / "conf";
     std::filesystem::create_directories(confDir);
 
-    std::ofstream dist(confDir / "distributions");
+    // 已有配置时只追加新的发行版
+    auto distFile = confDir / "distributions";
+    auto existing = detail::distributionCodenames(repoDir);
+    bool hasConfig = std::filesystem::exists(distFile) && std::filesystem::file_size(distFile) > 0;
+
+    std::ofstream dist(distFile, std::ios::app);
     if (!dist.is_open()) {
         std::cerr << _("Error: Unable to create distributions file") << "\n";
         return false;
     }
 
-    dist << "Origin: Lingmo OS\n"
-         << "Label: Lingmo\n"
-         << "Codename: " << codename << "\n"
-         << "Architectures: i386 amd64 arm64 source\n"
-         << "Components: main\n"
-         << "Description: Lingmo OS " << codename << " Repository\n"
-         << "SignWith: yes\n";
+    std::string componentList;
+    for (const auto& component : components) {
+        componentList += (componentList.empty() ? "" : " ") + component;
+    }
+
+    for (const auto& codename : codenames) {
+        if (std::find(existing.begin(), existing.end(), codename) != existing.end()) {
+            std::cout << _("Distribution already configured") << ": " << codename << "\n";
+            continue;
+        }
+
+        if (hasConfig) dist << "\n";
+        dist << "Origin: Lingmo OS\n"
+             << "Label: Lingmo\n"
+             << "Codename: " << codename << "\n"
+             << "Architectures: i386 amd64 arm64 source\n"
+             << "Components: " << componentList << "\n"
+             << "Description: Lingmo OS " << codename << " Repository\n"
+             // 仅让 reprepro 输出未压缩索引，压缩格式和 by-hash 由 RepoPublisher 生成
+             << "DebIndices: Packages Release .\n"
+             << "DscIndices: Sources Release .\n"
+             << "SignWith: yes\n"
+             // reprepro 默认 Limit: 1，导入新版本时会删除旧版本，--gc 的保留策略依赖于保留所有版本
+             << "Limit: 0\n";
+        hasConfig = true;
+    }
 
     return true;
 }
 
+bool RepoManager::ensureVersionLimit(const std::filesystem::path& repoDir) {
+    auto distFile = repoDir / "conf" / "distributions";
+    std::ifstream in(distFile);
+    if (!in.is_open()) return true;  // 由 reprepro 报告缺少配置
+
+    std::vector<std::string> lines;
+    std::string line;
+    bool changed = false;
+    bool hasCodename = false;
+    bool hasLimit = false;
+    auto finishStanza = [&]() {
+        if (hasCodename && !hasLimit) {
+            lines.push_back("Limit: 0");
+            changed = true;
+        }
+        hasCodename = hasLimit = false;
+    };
+    while (std::getline(in, line)) {
+        if (line.find_first_not_of(" \t") == std::string::npos) {
+            finishStanza();
+        } else if (line.compare(0, 9, "Codename:") == 0) {
+            hasCodename = true;
+        } else if (line.compare(0, 6, "Limit:") == 0) {
+            hasLimit = true;
+        }
+        lines.push_back(line);
+    }
+    finishStanza();
+    in.close();
+    if (!changed) return true;
+
+    // 旧版本创建的仓库没有 Limit 行，补上后 reprepro 才会保留旧版本供 --gc 按数量清理
+    auto tmp = detail::uniqueTempPath(distFile);
+    {
+        std::ofstream out(tmp);
+        for (const auto& entry : lines) {
+            out << entry << "\n";
+        }
+        if (!out) {
+            std::cerr << _("Error: Unable to create distributions file") << "\n";
+            std::filesystem::remove(tmp);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmp, distFile);
+    std::cout << _("Added \"Limit: 0\" to conf/distributions so that older versions are kept") << "\n";
+    return true;
+}
+
 bool RepoManager::initRepo(const std::filesystem::path& repoDir, 
                          const std::string& codename) {
+    return initRepo(repoDir, std::vector<std::string>{ codename }, { "main" });
+}
+
+bool RepoManager::initRepo(const std::filesystem::path& repoDir,
+                         const std::vector<std::string>& codenames,
+                         const std::vector<std::string>& components) {
     if (!checkReprepro()) return false;
 
+    if (codenames.empty() || components.empty()) {
+        std::cerr << _("Error: At least one codename and component are required") << "\n";
+        return false;
+    }
+
     std::filesystem::create_directories(repoDir);
 
-    if (!createRepoConfig(repoDir, codename)) {
+    if (!createRepoConfig(repoDir, codenames, components)) {
         std::cerr << _("Error: Failed to create repository configuration") << "\n";
         return false;
     }
 
+    // lingmo-repotool 自身的发布选项，与 reprepro 的配置分开存放
+    auto toolConf = repoDir / "conf" / "lingmo-repotool";
+    if (!std::filesystem::exists(toolConf)) {
+        std::ofstream conf(toolConf);
+        conf << "# Packages.diff 保留的历史补丁数量，0 表示不生成\n"
+             << "PDiffDepth: 14\n";
+    }
+
     std::cout << _("Repository initialized successfully at") << ": " << repoDir << "\n";
     return true;
 }
 
+bool RepoManager::exportRepo(const std::filesystem::path& repoDir,
+                             const std::string& codename) {
+    if (!checkReprepro()) return false;
+
+    // 在新快照中导出，完成后原子切换，客户端不会看到半更新的索引
+    return SnapshotManager::publish(repoDir, codename);
+}
+
 bool RepoManager::importChanges(const std::filesystem::path& repoDir,
                               const std::filesystem::path& changesFile,
                               const std::string& codename) {
-    if (!checkReprepro()) return false;
+    if (!checkReprepro() || !ensureVersionLimit(repoDir)) return false;
 
     if (!std::filesystem::exists(changesFile)) {
         std::cerr << _("Error: Changes file not found") << ": " << changesFile << "\n";
@@ -75,11 +234,13 @@ bool RepoManager::importChanges(const std::filesystem::path& repoDir,
     }
 
     std::string cmd = "cd " + repoDir.string() + " && "
-                    + "reprepro -V --ignore=wrongdistribution include "
+                    + "reprepro -V --export=never --ignore=wrongdistribution include "
                     + codename + " "
                     + changesFile.string();
 
-    return runRepreproCommand(cmd);
+    bool success = runRepreproCommand(cmd);
+    recordImport(codename, "changes", success);
+    return success;
 }
 
 bool RepoManager::importChangesDir(const std::filesystem::path& repoDir,
@@ -110,7 +271,7 @@ bool RepoManager::importDeb(const std::filesystem::path& repoDir,
                           const std::filesystem::path& debFile,
                           const std::string& codename,
                           const std::string& component) {
-    if (!checkReprepro()) return false;
+    if (!checkReprepro() || !ensureVersionLimit(repoDir)) return false;
 
     // 检查是否存在对应的源码包
     auto debPath = debFile.string();
@@ -121,7 +282,7 @@ bool RepoManager::importDeb(const std::filesystem::path& repoDir,
     // 如果存在源码包，先导入源码包
     if (std::filesystem::exists(dscPath)) {
         std::string srcCmd = "cd " + repoDir.string() + " && "
-                         + "reprepro -V includedsc "
+                         + "reprepro -V --export=never -C " + component + " includedsc "
                          + codename + " "
                          + dscPath;
         
@@ -129,22 +290,25 @@ bool RepoManager::importDeb(const std::filesystem::path& repoDir,
             std::cerr << _("Warning: Failed to import source package") << "\n";
             success = false;
         }
+        recordImport(codename, "dsc", success);
     }
 
     // 导入二进制包
     std::string cmd = "cd " + repoDir.string() + " && "
-                    + "reprepro -V includedeb "
+                    + "reprepro -V --export=never -C " + component + " includedeb "
                     + codename + " "
                     + debFile.string();
 
-    return runRepreproCommand(cmd) && success;
+    bool imported = runRepreproCommand(cmd);
+    recordImport(codename, "deb", imported);
+    return imported && success;
 }
 
 bool RepoManager::importDebDir(const std::filesystem::path& repoDir,
                              const std::filesystem::path& directory,
                              const std::string& codename,
                              const std::string& component) {
-    if (!checkReprepro()) return false;
+    if (!checkReprepro() || !ensureVersionLimit(repoDir)) return false;
 
     bool success = true;
 
@@ -153,14 +317,16 @@ bool RepoManager::importDebDir(const std::filesystem::path& repoDir,
         if (entry.path().extension() == ".dsc") {
             std::cout << _("Importing source") << " " << entry.path().filename() << "...\n";
             std::string srcCmd = "cd " + repoDir.string() + " && "
-                             + "reprepro -V includedsc "
+                             + "reprepro -V --export=never -C " + component + " includedsc "
                              + codename + " "
                              + entry.path().string();
             
-            if (!runRepreproCommand(srcCmd)) {
+            bool imported = runRepreproCommand(srcCmd);
+            if (!imported) {
                 std::cerr << _("Failed to import source") << " " << entry.path() << "\n";
                 success = false;
             }
+            recordImport(codename, "dsc", imported);
         }
     }
 
@@ -169,18 +335,173 @@ bool RepoManager::importDebDir(const std::filesystem::path& repoDir,
         if (entry.path().extension() == ".deb") {
             std::cout << _("Importing binary") << " " << entry.path().filename() << "...\n";
             std::string cmd = "cd " + repoDir.string() + " && "
-                          + "reprepro -V includedeb "
+                          + "reprepro -V --export=never -C " + component + " includedeb "
                           + codename + " "
                           + entry.path().string();
             
-            if (!runRepreproCommand(cmd)) {
+            bool imported = runRepreproCommand(cmd);
+            if (!imported) {
                 std::cerr << _("Failed to import binary") << " " << entry.path() << "\n";
                 success = false;
             }
+            recordImport(codename, "deb", imported);
         }
     }
 
     return success;
 }
 
-} // namespace lingmo 
\ No newline at end of file
+bool RepoManager::garbageCollect(const std::filesystem::path& repoDir,
+                                 const std::string& codename,
+                                 int keep) {
+    if (!checkReprepro() || !ensureVersionLimit(repoDir)) return false;
+
+    if (keep < 1) {
+        std::cerr << _("Error: Number of versions to keep must be greater than 0") << "\n";
+        return false;
+    }
+
+    // 按 (类型, 组件, 架构, 包名) 分组列出发行版中的所有版本
+    std::string listing;
+    std::string listCmd = "cd " + repoDir.string() + " && "
+                        + "reprepro --list-format '${$type}\\t${$component}\\t${$architecture}\\t${package}\\t${version}\\n' "
+                        + "list " + codename;
+    if (!detail::captureCommand(listCmd, listing)) {
+        std::cerr << _("Error: Failed to list repository contents") << "\n";
+        return false;
+    }
+
+    using Key = std::tuple<std::string, std::string, std::string, std::string>;
+    std::map<Key, std::vector<std::string>> versions;
+    std::istringstream lines(listing);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::vector<std::string> fields;
+        std::istringstream fieldStream(line);
+        std::string field;
+        while (std::getline(fieldStream, field, '\t')) fields.push_back(field);
+        if (fields.size() != 5) continue;
+        versions[{fields[0], fields[1], fields[2], fields[3]}].push_back(fields[4]);
+    }
+
+    bool success = true;
+    int removed = 0;
+    for (auto& [key, list] : versions) {
+        if (static_cast<int>(list.size()) <= keep) continue;
+
+        std::sort(list.begin(), list.end(), [](const std::string& a, const std::string& b) {
+            return DebianVersion::compare(a, b) > 0;
+        });
+
+        const auto& [type, component, architecture, package] = key;
+        for (size_t i = keep; i < list.size(); ++i) {
+            std::cout << _("Removing") << " " << package << " " << list[i]
+                      << " (" << architecture << ")\n";
+            std::string cmd = "cd " + repoDir.string() + " && "
+                            + "reprepro --export=never"
+                            + " -T " + type + " -C " + component + " -A " + architecture
+                            + " remove " + codename + " " + detail::shellQuote(package + "=" + list[i]);
+            if (!runRepreproCommand(cmd)) {
+                std::cerr << _("Failed to remove") << " " << package << " " << list[i] << "\n";
+                success = false;
+                continue;
+            }
+            ++removed;
+        }
+    }
+
+    // 通过 reprepro 的引用数据库找出无人引用的 pool 文件，无需扫描文件系统
+    std::string unreferenced;
+    std::string dumpCmd = "cd " + repoDir.string() + " && reprepro dumpunreferenced";
+    if (!detail::captureCommand(dumpCmd, unreferenced)) {
+        std::cerr << _("Error: Failed to list unreferenced files") << "\n";
+        return false;
+    }
+
+    std::uintmax_t reclaimed = 0;
+    int orphans = 0;
+    std::istringstream orphanLines(unreferenced);
+    while (std::getline(orphanLines, line)) {
+        if (line.empty()) continue;
+        std::error_code ec;
+        auto size = std::filesystem::file_size(repoDir / line, ec);
+        // 仍被快照硬链接的文件删除后并不会释放空间
+        if (!ec && std::filesystem::hard_link_count(repoDir / line, ec) == 1) {
+            reclaimed += size;
+        }
+        // 同时丢弃该文件的 Contents 缓存
+        std::filesystem::remove(repoDir / "db" / "contents" / (line + ".list"), ec);
+        ++orphans;
+    }
+
+    if (orphans > 0) {
+        std::string deleteCmd = "cd " + repoDir.string() + " && reprepro deleteunreferenced";
+        if (!runRepreproCommand(deleteCmd)) {
+            std::cerr << _("Error: Failed to delete unreferenced files") << "\n";
+            return false;
+        }
+    }
+
+    if (removed > 0 && !exportRepo(repoDir, codename)) {
+        success = false;
+    }
+
+    std::cout << _("Removed versions") << ": " << removed << ", "
+              << _("deleted pool files") << ": " << orphans << ", "
+              << _("reclaimed bytes") << ": " << reclaimed << "\n";
+    return success;
+}
+
+bool RepoManager::promote(const std::filesystem::path& repoDir,
+                          const std::string& from,
+                          const std::string& to,
+                          const std::vector<std::string>& packages) {
+    if (!checkReprepro() || !ensureVersionLimit(repoDir)) return false;
+
+    bool success = true;
+    for (const auto& spec : packages) {
+        auto eq = spec.find('=');
+        std::string cmd = "cd " + repoDir.string() + " && reprepro -V --export=never ";
+        if (eq == std::string::npos) {
+            cmd += "copy " + to + " " + from + " " + detail::shellQuote(spec);
+        } else {
+            // 指定版本时用过滤条件精确匹配
+            cmd += "copyfilter " + to + " " + from + " "
+                 + detail::shellQuote("Package (== " + spec.substr(0, eq) + "), Version (== "
+                                      + spec.substr(eq + 1) + ")");
+        }
+
+        std::cout << _("Promoting") << " " << spec << " " << from << " -> " << to << "\n";
+        if (!runRepreproCommand(cmd)) {
+            std::cerr << _("Failed to promote") << " " << spec << "\n";
+            success = false;
+        }
+    }
+
+    // pool 文件和校验和直接复用，只需导出目标发行版
+    return exportRepo(repoDir, to) && success;
+}
+
+bool RepoManager::promoteSource(const std::filesystem::path& repoDir,
+                                const std::string& from,
+                                const std::string& to,
+                                const std::string& source,
+                                const std::string& version) {
+    if (!checkReprepro() || !ensureVersionLimit(repoDir)) return false;
+
+    std::string cmd = "cd " + repoDir.string() + " && reprepro -V --export=never "
+                    + "copysrc " + to + " " + from + " " + detail::shellQuote(source);
+    if (!version.empty()) {
+        cmd += " " + detail::shellQuote(version);
+    }
+
+    std::cout << _("Promoting source") << " " << source << " " << from << " -> " << to << "\n";
+    bool success = runRepreproCommand(cmd);
+    if (!success) {
+        std::cerr << _("Failed to promote") << " " << source << "\n";
+    }
+
+    return exportRepo(repoDir, to) && success;
+}
+
+} // namespace lingmo
\ No newline at end of file
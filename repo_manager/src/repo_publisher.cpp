@@ -0,0 +1,313 @@
+#include "repo_publisher.h"
+#include "contents_generator.h"
+#include "pdiff_generator.h"
+#include "repo_utils.h"
+#include "parallel_for.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <algorithm>
+#include <set>
+#include <map>
+#include <ctime>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+namespace lingmo {
+
+namespace {
+
+struct Compressor {
+    const char* extension;
+    const char* command;   // 从标准输入读取，输出到标准输出
+};
+
+// gzip 使用 -n 保证相同内容得到相同的压缩结果
+const Compressor kCompressors[] = {
+    { ".gz",  "gzip -9nc" },
+    { ".xz",  "xz -6c" },
+    { ".zst", "zstd -19 -q -c" },
+};
+
+bool isIndexName(const std::string& name) {
+    if (name == "Packages" || name == "Sources") return true;
+    // Contents-<arch>，不包括已压缩的变体
+    return name.compare(0, 9, "Contents-") == 0 && name.find('.') == std::string::npos;
+}
+
+std::string rfc2822Now() {
+    std::time_t now = std::time(nullptr);
+    std::tm tm{};
+    gmtime_r(&now, &tm);
+    char buf[64];
+    std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S UTC", &tm);
+    return buf;
+}
+
+} // namespace
+
+std::vector<std::filesystem::path> RepoPublisher::findIndexFiles(const std::filesystem::path& distDir) {
+    std::vector<std::filesystem::path> indexes;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(distDir)) {
+        if (!entry.is_regular_file()) continue;
+        if (entry.path().parent_path().parent_path().filename() == "by-hash") continue;
+        if (entry.path().parent_path().extension() == ".diff") continue;
+        if (isIndexName(entry.path().filename().string())) {
+            indexes.push_back(entry.path());
+        }
+    }
+    return indexes;
+}
+
+bool RepoPublisher::compressIndexes(const std::vector<std::filesystem::path>& indexes) {
+    bool haveZstd = detail::commandExists("zstd");
+    if (!haveZstd) {
+        std::cerr << _("Warning: zstd not found, skipping .zst indexes") << "\n";
+    }
+
+    std::vector<std::pair<std::filesystem::path, const Compressor*>> jobs;
+    for (const auto& index : indexes) {
+        for (const auto& compressor : kCompressors) {
+            std::string ext = compressor.extension;
+            if (ext == ".zst" && !haveZstd) {
+                // 删除旧的 .zst，避免继续发布过期内容
+                std::filesystem::remove(index.string() + ext);
+                continue;
+            }
+            jobs.emplace_back(index, &compressor);
+        }
+    }
+
+    std::atomic<bool> success{true};
+    parallelFor(jobs.size(), [&jobs, &success](size_t i) {
+        const auto& [index, compressor] = jobs[i];
+        // 先写临时文件再改名，避免客户端读到半截文件
+        auto target = index.string() + compressor->extension;
+        auto tmp = target + ".new";
+        std::string full = std::string(compressor->command) + " < " + detail::shellQuote(index)
+                         + " > " + detail::shellQuote(tmp);
+        if (std::system(full.c_str()) != 0) {
+            std::filesystem::remove(tmp);
+            success = false;
+            return;
+        }
+        std::filesystem::rename(tmp, target);
+    });
+
+    if (!success) {
+        std::cerr << _("Error: Failed to compress index files") << "\n";
+    }
+    return success;
+}
+
+std::vector<RepoPublisher::IndexEntry> RepoPublisher::collectEntries(const std::filesystem::path& distDir) {
+    std::vector<std::filesystem::path> files;
+    for (auto it = std::filesystem::recursive_directory_iterator(distDir);
+         it != std::filesystem::recursive_directory_iterator(); ++it) {
+        if (it->is_directory() && it->path().filename() == "by-hash") {
+            it.disable_recursion_pending();
+            continue;
+        }
+        if (!it->is_regular_file()) continue;
+
+        auto rel = std::filesystem::relative(it->path(), distDir);
+        auto name = rel.string();
+        // 顶层签名文件本身不列入 Release
+        if (name == "Release" || name == "InRelease" || name == "Release.gpg") continue;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".new") == 0) continue;
+        files.push_back(rel);
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector<IndexEntry> entries(files.size());
+    parallelFor(files.size(), [&distDir, &files, &entries](size_t i) {
+        IndexEntry& entry = entries[i];
+        entry.path = files[i];
+        entry.size = std::filesystem::file_size(distDir / files[i]);
+        entry.md5 = detail::fileDigest("md5sum", distDir / files[i]);
+        entry.sha256 = detail::fileDigest("sha256sum", distDir / files[i]);
+    });
+    return entries;
+}
+
+bool RepoPublisher::writeByHash(const std::filesystem::path& distDir,
+                                const std::vector<IndexEntry>& entries) {
+    try {
+        // 记录每个 by-hash 目录中本次发布引用的文件
+        std::map<std::filesystem::path, std::set<std::string>> current;
+
+        for (const auto& entry : entries) {
+            auto name = entry.path.filename().string();
+            if (!isIndexName(name) && !isIndexName(entry.path.stem().string())) continue;
+            if (entry.md5.empty() || entry.sha256.empty()) return false;
+
+            auto source = distDir / entry.path;
+            auto byHashDir = source.parent_path() / "by-hash";
+            for (const auto& [algo, digest] : { std::make_pair("MD5Sum", entry.md5),
+                                                std::make_pair("SHA256", entry.sha256) }) {
+                auto dir = byHashDir / algo;
+                std::filesystem::create_directories(dir);
+                auto target = dir / digest;
+                current[dir].insert(digest);
+                if (std::filesystem::exists(target)) continue;
+
+                // 优先使用硬链接，跨文件系统时退回复制
+                std::error_code ec;
+                std::filesystem::create_hard_link(source, target, ec);
+                if (ec) {
+                    std::filesystem::copy_file(source, target);
+                }
+            }
+        }
+
+        // 清理未被引用且超出保留数量的旧副本
+        for (const auto& [dir, keep] : current) {
+            std::vector<std::filesystem::directory_entry> stale;
+            for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+                if (!keep.count(entry.path().filename().string())) {
+                    stale.push_back(entry);
+                }
+            }
+            if (stale.size() <= kByHashHistory) continue;
+
+            std::sort(stale.begin(), stale.end(), [](const auto& a, const auto& b) {
+                return a.last_write_time() > b.last_write_time();
+            });
+            for (size_t i = kByHashHistory; i < stale.size(); ++i) {
+                std::filesystem::remove(stale[i].path());
+            }
+        }
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << _("Error: Failed to write by-hash files") << ": " << e.what() << "\n";
+        return false;
+    }
+}
+
+bool RepoPublisher::writeRelease(const std::filesystem::path& repoDir,
+                                 const std::filesystem::path& distDir,
+                                 const std::string& codename,
+                                 const std::vector<IndexEntry>& entries) {
+    // 保留 reprepro 生成的头部字段，仅替换日期和摘要列表
+    std::ostringstream header;
+    {
+        std::ifstream release(distDir / "Release");
+        if (!release.is_open()) {
+            std::cerr << _("Error: Release file not found") << ": " << distDir / "Release" << "\n";
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(release, line)) {
+            if (line.empty() || std::isspace(static_cast<unsigned char>(line[0]))) continue;
+            auto key = line.substr(0, line.find(':'));
+            if (key == "MD5Sum" || key == "SHA1" || key == "SHA256" || key == "SHA512") continue;
+            if (key == "Date" || key == "Acquire-By-Hash") continue;
+            header << line << "\n";
+        }
+    }
+
+    auto tmp = distDir / "Release.new";
+    {
+        std::ofstream out(tmp);
+        if (!out.is_open()) {
+            std::cerr << _("Error: Unable to write Release file") << "\n";
+            return false;
+        }
+
+        out << header.str()
+            << "Date: " << rfc2822Now() << "\n"
+            << "Acquire-By-Hash: yes\n";
+
+        out << "MD5Sum:\n";
+        for (const auto& entry : entries) {
+            out << " " << entry.md5 << " " << entry.size << " " << entry.path.string() << "\n";
+        }
+        out << "SHA256:\n";
+        for (const auto& entry : entries) {
+            out << " " << entry.sha256 << " " << entry.size << " " << entry.path.string() << "\n";
+        }
+    }
+
+    if (!signRelease(repoDir, distDir, codename)) {
+        std::filesystem::remove(tmp);
+        return false;
+    }
+
+    // 签名文件先就位，Release 最后替换
+    for (const char* name : { "Release.gpg", "InRelease" }) {
+        auto signedTmp = distDir / (std::string(name) + ".new");
+        if (std::filesystem::exists(signedTmp)) {
+            std::filesystem::rename(signedTmp, distDir / name);
+        }
+    }
+    std::filesystem::rename(tmp, distDir / "Release");
+    return true;
+}
+
+bool RepoPublisher::signRelease(const std::filesystem::path& repoDir,
+                                const std::filesystem::path& distDir,
+                                const std::string& codename) {
+    std::string signWith = detail::distributionField(repoDir, codename, "SignWith");
+    if (signWith.empty() || signWith == "no") {
+        return true;
+    }
+
+    std::string gpg = "gpg --batch --yes";
+    if (signWith != "yes" && signWith != "default") {
+        gpg += " --local-user " + detail::shellQuote(signWith);
+    }
+
+    auto release = detail::shellQuote(distDir / "Release.new");
+    std::string clearsign = gpg + " --clearsign -o "
+                          + detail::shellQuote(distDir / "InRelease.new") + " " + release;
+    std::string detach = gpg + " --armor --detach-sign -o "
+                       + detail::shellQuote(distDir / "Release.gpg.new") + " " + release;
+
+    if (std::system(clearsign.c_str()) != 0 || std::system(detach.c_str()) != 0) {
+        std::cerr << _("Error: Failed to sign Release file") << "\n";
+        std::filesystem::remove(distDir / "InRelease.new");
+        std::filesystem::remove(distDir / "Release.gpg.new");
+        return false;
+    }
+    return true;
+}
+
+bool RepoPublisher::publish(const std::filesystem::path& repoDir,
+                            const std::filesystem::path& distsDir,
+                            const std::string& codename) {
+    auto distDir = distsDir / codename;
+    if (!std::filesystem::exists(distDir / "Release")) {
+        std::cerr << _("Error: Distribution has not been exported") << ": " << distDir << "\n";
+        return false;
+    }
+
+    try {
+        std::cout << _("Publishing indexes for") << " " << codename << "...\n";
+
+        // Contents 缺失不影响软件包索引发布，仅给出警告
+        if (!ContentsGenerator::generate(repoDir, distsDir, codename)) {
+            std::cerr << _("Warning: Contents indexes are incomplete") << "\n";
+        }
+
+        // 补丁缺失时客户端会退回下载完整索引
+        if (!PDiffGenerator::generate(repoDir, distsDir, codename)) {
+            std::cerr << _("Warning: Index diffs were not updated") << "\n";
+        }
+
+        if (!compressIndexes(findIndexFiles(distDir))) return false;
+
+        auto entries = collectEntries(distDir);
+        if (!writeByHash(distDir, entries)) return false;
+        if (!writeRelease(repoDir, distDir, codename, entries)) return false;
+
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << _("Error: Failed to publish indexes") << ": " << e.what() << "\n";
+        return false;
+    }
+}
+
+} // namespace lingmo
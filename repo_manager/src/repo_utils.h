@@ -0,0 +1,156 @@
+#pragma once
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <vector>
+#include <functional>
+#include <filesystem>
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+
+namespace lingmo {
+namespace detail {
+
+// 为 shell 命令转义参数
+inline std::string shellQuote(const std::string& arg) {
+    std::string quoted = "'";
+    for (char c : arg) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    quoted += "'";
+    return quoted;
+}
+
+inline std::string shellQuote(const std::filesystem::path& path) {
+    return shellQuote(path.string());
+}
+
+// 执行命令并获取标准输出，失败时返回 false
+inline bool captureCommand(const std::string& cmd, std::string& output) {
+    output.clear();
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (!pipe) return false;
+
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+        output.append(buffer, n);
+    }
+    return pclose(pipe) == 0;
+}
+
+// 使用 md5sum/sha256sum 等工具计算文件摘要
+inline std::string fileDigest(const std::string& tool, const std::filesystem::path& file) {
+    std::string output;
+    if (!captureCommand(tool + " " + shellQuote(file), output)) {
+        return "";
+    }
+    return output.substr(0, output.find(' '));
+}
+
+// 检查命令是否存在
+inline bool commandExists(const std::string& name) {
+    return std::system(("which " + name + " > /dev/null 2>&1").c_str()) == 0;
+}
+
+// 与 target 同目录、以 .new 结尾的临时文件名，包含进程号和线程号，并发的写入者互不覆盖
+inline std::filesystem::path uniqueTempPath(const std::filesystem::path& target) {
+    auto tmp = target;
+    tmp += "." + std::to_string(getpid()) + "."
+         + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".new";
+    return tmp;
+}
+
+// 从 conf/distributions 中读取指定发行版的字段值
+inline std::string distributionField(const std::filesystem::path& repoDir,
+                                     const std::string& codename,
+                                     const std::string& field) {
+    std::ifstream dist(repoDir / "conf" / "distributions");
+    std::string line;
+    std::string stanzaCodename;
+    std::string value;
+    auto finish = [&]() {
+        bool match = stanzaCodename == codename;
+        stanzaCodename.clear();
+        if (!match) value.clear();
+        return match;
+    };
+
+    while (std::getline(dist, line)) {
+        if (line.empty()) {
+            if (finish()) return value;
+            continue;
+        }
+        auto colon = line.find(':');
+        if (colon == std::string::npos || std::isspace(static_cast<unsigned char>(line[0]))) continue;
+        std::string key = line.substr(0, colon);
+        std::string val = line.substr(colon + 1);
+        val.erase(0, val.find_first_not_of(" \t"));
+        if (key == "Codename") {
+            stanzaCodename = val;
+        } else if (key == field) {
+            value = val;
+        }
+    }
+    return finish() ? value : "";
+}
+
+// 列出 conf/distributions 中配置的所有发行版代号
+inline std::vector<std::string> distributionCodenames(const std::filesystem::path& repoDir) {
+    std::vector<std::string> codenames;
+    std::ifstream dist(repoDir / "conf" / "distributions");
+    std::string line;
+    while (std::getline(dist, line)) {
+        if (line.compare(0, 9, "Codename:") == 0) {
+            std::string value = line.substr(9);
+            value.erase(0, value.find_first_not_of(" \t"));
+            codenames.push_back(value);
+        }
+    }
+    return codenames;
+}
+
+// 逐段读取 deb822 格式文件 (Packages, Sources, .changes)，续行保留换行
+using Stanza = std::map<std::string, std::string>;
+
+inline bool forEachStanza(const std::filesystem::path& file,
+                          const std::function<void(const Stanza&)>& callback) {
+    std::ifstream in(file);
+    if (!in.is_open()) return false;
+
+    Stanza stanza;
+    std::string line;
+    std::string lastKey;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            if (!stanza.empty()) callback(stanza);
+            stanza.clear();
+            lastKey.clear();
+            continue;
+        }
+        if (line[0] == '#') continue;
+        if (std::isspace(static_cast<unsigned char>(line[0]))) {
+            if (!lastKey.empty()) stanza[lastKey] += "\n" + line.substr(1);
+            continue;
+        }
+        auto colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        lastKey = line.substr(0, colon);
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        stanza[lastKey] = value;
+    }
+    if (!stanza.empty()) callback(stanza);
+    return true;
+}
+
+} // namespace detail
+} // namespace lingmo
@@ -0,0 +1,330 @@
+#include "snapshot_manager.h"
+#include "repo_publisher.h"
+#include "pdiff_generator.h"
+#include "repo_utils.h"
+#include "metrics.h"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <ctime>
+#include <chrono>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+namespace lingmo {
+
+namespace {
+
+std::string timestamp() {
+    std::time_t now = std::time(nullptr);
+    std::tm tm{};
+    gmtime_r(&now, &tm);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y%m%dT%H%M%SZ", &tm);
+    return buf;
+}
+
+void linkFile(const std::filesystem::path& from, const std::filesystem::path& to) {
+    std::filesystem::create_directories(to.parent_path());
+    std::error_code ec;
+    std::filesystem::create_hard_link(from, to, ec);
+    if (ec) {
+        // 不同文件系统无法硬链接时退回复制
+        std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing);
+    }
+}
+
+} // namespace
+
+std::string SnapshotManager::liveSnapshot(const std::filesystem::path& repoDir) {
+    auto dists = repoDir / "dists";
+    if (!std::filesystem::is_symlink(dists)) return "";
+
+    // 链接目标形如 snapshots/<name>/dists
+    return std::filesystem::read_symlink(dists).parent_path().filename().string();
+}
+
+void SnapshotManager::linkTree(const std::filesystem::path& from,
+                               const std::filesystem::path& to,
+                               const std::filesystem::path& skip) {
+    for (auto it = std::filesystem::recursive_directory_iterator(from);
+         it != std::filesystem::recursive_directory_iterator(); ++it) {
+        auto rel = std::filesystem::relative(it->path(), from);
+        if (!skip.empty() && rel == skip) {
+            it.disable_recursion_pending();
+            continue;
+        }
+        if (it->is_directory()) {
+            std::filesystem::create_directories(to / rel);
+        } else if (it->is_regular_file()) {
+            linkFile(it->path(), to / rel);
+        }
+    }
+}
+
+bool SnapshotManager::linkPool(const std::filesystem::path& repoDir,
+                               const std::filesystem::path& snapshotDir) {
+    std::vector<std::string> poolFiles;
+    for (auto it = std::filesystem::recursive_directory_iterator(snapshotDir / "dists");
+         it != std::filesystem::recursive_directory_iterator(); ++it) {
+        if (it->is_directory() && (it->path().filename() == "by-hash" ||
+                                   it->path().extension() == ".diff")) {
+            it.disable_recursion_pending();
+            continue;
+        }
+
+        auto name = it->path().filename().string();
+        if (name == "Packages") {
+            detail::forEachStanza(it->path(), [&](const detail::Stanza& stanza) {
+                auto filename = stanza.find("Filename");
+                if (filename != stanza.end()) poolFiles.push_back(filename->second);
+            });
+        } else if (name == "Sources") {
+            detail::forEachStanza(it->path(), [&](const detail::Stanza& stanza) {
+                auto directory = stanza.find("Directory");
+                auto files = stanza.find("Files");
+                if (directory == stanza.end() || files == stanza.end()) return;
+
+                // Files 字段的每一行为 "md5 size name"
+                std::istringstream lines(files->second);
+                std::string md5, size, file;
+                while (lines >> md5 >> size >> file) {
+                    poolFiles.push_back(directory->second + "/" + file);
+                }
+            });
+        }
+    }
+
+    std::sort(poolFiles.begin(), poolFiles.end());
+    poolFiles.erase(std::unique(poolFiles.begin(), poolFiles.end()), poolFiles.end());
+
+    bool success = true;
+    for (const auto& file : poolFiles) {
+        auto source = repoDir / file;
+        auto target = snapshotDir / file;
+        if (std::filesystem::exists(target)) continue;
+        if (!std::filesystem::exists(source)) {
+            std::cerr << _("Warning: Pool file missing") << ": " << file << "\n";
+            success = false;
+            continue;
+        }
+        linkFile(source, target);
+    }
+    return success;
+}
+
+bool SnapshotManager::copyDatabase(const std::filesystem::path& from, const std::filesystem::path& to,
+                                   bool cloneOnly) {
+    std::filesystem::create_directories(to);
+    std::string files;
+    for (const auto& entry : std::filesystem::directory_iterator(from)) {
+        if (!entry.is_regular_file() || entry.path().filename() == "lingmo-repotool.lock") continue;
+        if (cloneOnly) {
+            files += " " + detail::shellQuote(entry.path());
+            continue;
+        }
+        // reprepro 会原地修改数据库文件，因此必须复制而不是硬链接
+        std::filesystem::copy_file(entry.path(), to / entry.path().filename(),
+            std::filesystem::copy_options::overwrite_existing);
+    }
+    if (!cloneOnly || files.empty()) return true;
+
+    // reflink 副本与原文件共享数据块，只有之后被修改的部分占用空间
+    std::string cmd = "cp --reflink=always --" + files + " " + detail::shellQuote(to) + " 2>/dev/null";
+    if (std::system(cmd.c_str()) != 0) {
+        std::error_code ec;
+        std::filesystem::remove_all(to, ec);
+        return false;
+    }
+    return true;
+}
+
+bool SnapshotManager::switchTo(const std::filesystem::path& repoDir, const std::string& name) {
+    auto dists = repoDir / "dists";
+
+    // 旧版仓库的 dists 是普通目录，先把它保存为一个快照
+    if (std::filesystem::exists(dists) && !std::filesystem::is_symlink(dists)) {
+        auto legacy = repoDir / "snapshots" / ("legacy-" + timestamp());
+        std::filesystem::create_directories(legacy);
+        std::filesystem::rename(dists, legacy / "dists");
+        std::cout << _("Existing dists moved to snapshot") << " " << legacy.filename() << "\n";
+    }
+
+    // 先创建临时链接，再用 rename 原子替换，客户端不会看到中间状态
+    auto tmpLink = repoDir / "dists.new";
+    std::filesystem::remove(tmpLink);
+    std::filesystem::create_directory_symlink(std::filesystem::path("snapshots") / name / "dists", tmpLink);
+    std::filesystem::rename(tmpLink, dists);
+    return true;
+}
+
+void SnapshotManager::pruneAutomatic(const std::filesystem::path& repoDir) {
+    auto snapshotsDir = repoDir / "snapshots";
+    std::string live = liveSnapshot(repoDir);
+
+    std::vector<std::string> automatic;
+    for (const auto& entry : std::filesystem::directory_iterator(snapshotsDir)) {
+        auto name = entry.path().filename().string();
+        if (entry.is_directory() && name.compare(0, 5, "auto-") == 0 && name != live) {
+            automatic.push_back(name);
+        }
+    }
+    if (automatic.size() <= kKeepAutomatic) return;
+
+    // 名称带时间戳，按名称排序即按时间排序
+    std::sort(automatic.begin(), automatic.end(), std::greater<std::string>());
+    for (size_t i = kKeepAutomatic; i < automatic.size(); ++i) {
+        std::filesystem::remove_all(snapshotsDir / automatic[i]);
+    }
+}
+
+bool SnapshotManager::publish(const std::filesystem::path& repoDir,
+                              const std::string& codename,
+                              const std::string& name) {
+    auto start = std::chrono::steady_clock::now();
+    bool success = publishSnapshot(repoDir, codename, name);
+
+    Metrics::Labels labels = { { "codename", codename } };
+    Metrics::set("lingmo_repo_publish_duration_seconds", labels,
+                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    Metrics::set("lingmo_repo_publish_success", labels, success ? 1 : 0);
+    Metrics::set("lingmo_repo_last_publish_timestamp_seconds", labels, static_cast<double>(std::time(nullptr)));
+    return success;
+}
+
+bool SnapshotManager::publishSnapshot(const std::filesystem::path& repoDir,
+                              const std::string& codename,
+                              const std::string& name) {
+    std::string snapshotName = name;
+    if (snapshotName.empty()) {
+        snapshotName = "auto-" + timestamp();
+        for (int i = 1; std::filesystem::exists(repoDir / "snapshots" / snapshotName); ++i) {
+            snapshotName = "auto-" + timestamp() + "-" + std::to_string(i);
+        }
+    } else if (snapshotName.find('/') != std::string::npos ||
+               std::filesystem::exists(repoDir / "snapshots" / snapshotName)) {
+        std::cerr << _("Error: Invalid or existing snapshot name") << ": " << snapshotName << "\n";
+        return false;
+    }
+
+    auto snapshotDir = std::filesystem::absolute(repoDir / "snapshots" / snapshotName);
+    auto stageDists = snapshotDir / "dists";
+
+    try {
+        std::filesystem::create_directories(stageDists);
+
+        // 其他发行版的索引不变，直接硬链接自当前快照
+        if (std::filesystem::exists(repoDir / "dists")) {
+            auto liveDists = std::filesystem::canonical(repoDir / "dists");
+            linkTree(liveDists, stageDists, codename);
+
+            // 保留本发行版旧的 by-hash 副本，正在更新的客户端仍能取到旧索引
+            if (std::filesystem::exists(liveDists / codename)) {
+                for (const auto& entry : std::filesystem::recursive_directory_iterator(liveDists / codename)) {
+                    if (entry.is_directory() && entry.path().filename() == "by-hash") {
+                        linkTree(entry.path(), stageDists / std::filesystem::relative(entry.path(), liveDists));
+                    }
+                }
+            }
+        }
+
+        std::string cmd = "cd " + detail::shellQuote(repoDir) + " && "
+                        + "reprepro -V --distdir " + detail::shellQuote(stageDists)
+                        + " export " + detail::shellQuote(codename);
+        if (std::system(cmd.c_str()) != 0) {
+            std::cerr << _("Error: Failed to export repository") << "\n";
+            std::filesystem::remove_all(snapshotDir);
+            return false;
+        }
+
+        if (!RepoPublisher::publish(repoDir, stageDists, codename)) {
+            PDiffGenerator::finish(repoDir, codename, false);
+            std::filesystem::remove_all(snapshotDir);
+            return false;
+        }
+
+        if (!linkPool(repoDir, snapshotDir)) {
+            std::cerr << _("Warning: Snapshot does not contain every referenced pool file") << "\n";
+        }
+        // 数据库与仓库大小成正比，完整副本只为命名快照保存；自动快照在每次导出时生成，
+        // 只在能以 reflink 克隆时保存，否则快照只占索引的空间
+        if (std::filesystem::exists(repoDir / "db")) {
+            copyDatabase(repoDir / "db", snapshotDir / "db", name.empty());
+        }
+
+        switchTo(repoDir, snapshotName);
+        // 新索引已对客户端可见，此时才提交补丁状态
+        PDiffGenerator::finish(repoDir, codename, true);
+        pruneAutomatic(repoDir);
+
+        std::cout << _("Published snapshot") << ": " << snapshotName << "\n";
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << _("Error: Failed to publish snapshot") << ": " << e.what() << "\n";
+        PDiffGenerator::finish(repoDir, codename, false);
+        std::error_code ec;
+        std::filesystem::remove_all(snapshotDir, ec);
+        return false;
+    }
+}
+
+bool SnapshotManager::rollback(const std::filesystem::path& repoDir, const std::string& name) {
+    auto snapshotDir = repoDir / "snapshots" / name;
+    if (name.empty() || !std::filesystem::exists(snapshotDir / "dists")) {
+        std::cerr << _("Error: Snapshot not found") << ": " << name << "\n";
+        return false;
+    }
+
+    try {
+        // 快照持有 pool 文件的硬链接，被清理掉的文件可以直接链接回来
+        auto snapshotPool = snapshotDir / "pool";
+        if (std::filesystem::exists(snapshotPool)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(snapshotPool)) {
+                if (!entry.is_regular_file()) continue;
+                auto target = repoDir / "pool" / std::filesystem::relative(entry.path(), snapshotPool);
+                if (!std::filesystem::exists(target)) {
+                    linkFile(entry.path(), target);
+                }
+            }
+        }
+
+        if (std::filesystem::exists(snapshotDir / "db")) {
+            copyDatabase(snapshotDir / "db", repoDir / "db");
+        } else {
+            std::cerr << _("Warning: Snapshot has no database copy; the reprepro database still describes "
+                           "the current packages and the next export will publish them again") << "\n";
+        }
+
+        switchTo(repoDir, name);
+        std::cout << _("Rolled back to snapshot") << ": " << name << "\n";
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << _("Error: Failed to roll back snapshot") << ": " << e.what() << "\n";
+        return false;
+    }
+}
+
+bool SnapshotManager::list(const std::filesystem::path& repoDir) {
+    auto snapshotsDir = repoDir / "snapshots";
+    if (!std::filesystem::exists(snapshotsDir)) {
+        std::cout << _("No snapshots") << "\n";
+        return true;
+    }
+
+    std::vector<std::string> names;
+    for (const auto& entry : std::filesystem::directory_iterator(snapshotsDir)) {
+        if (entry.is_directory()) names.push_back(entry.path().filename().string());
+    }
+    std::sort(names.begin(), names.end());
+
+    std::string live = liveSnapshot(repoDir);
+    for (const auto& name : names) {
+        std::cout << (name == live ? "* " : "  ") << name << "\n";
+    }
+    return true;
+}
+
+} // namespace lingmo
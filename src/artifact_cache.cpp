@@ -0,0 +1,245 @@
+#include "artifact_cache.h"
+#include "build_utils.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+#include <unistd.h>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+using build_utils::shellQuote;
+using build_utils::captureCommand;
+
+ArtifactCache::ArtifactCache(const std::string& location) : m_location(location) {
+    while (m_location.size() > 1 && m_location.back() == '/') {
+        m_location.pop_back();
+    }
+}
+
+bool ArtifactCache::isRemote() const {
+    return m_location.compare(0, 7, "http://") == 0 || m_location.compare(0, 8, "https://") == 0;
+}
+
+std::string ArtifactCache::entryPath(const std::string& key) const {
+    return m_location + "/" + key.substr(0, 2) + "/" + key;
+}
+
+std::string ArtifactCache::computeKey(const std::string& sourceHash,
+                                      const std::vector<std::string>& buildDepends,
+                                      const std::string& options,
+                                      const std::map<std::string, std::string>& treeOutputs,
+                                      const std::filesystem::path& root) {
+    std::ostringstream fingerprint;
+    fingerprint << "source " << sourceHash << "\n"
+                << "options " << options << "\n";
+
+    // 主机架构在进程内不会变化，只查询一次
+    static const std::string arch = []() {
+        std::string output;
+        captureCommand("dpkg --print-architecture", output);
+        return build_utils::firstWord(output);
+    }();
+    fingerprint << "arch " << arch << "\n";
+
+    // 构建环境指纹：每个构建依赖将要使用的版本，没有可用版本的依赖不会出现在输出中
+    if (!buildDepends.empty()) {
+        std::string names;
+        for (const auto& name : buildDepends) {
+            names += " " + shellQuote(name);
+        }
+
+        std::vector<std::string> lines;
+        std::string line;
+        if (root.empty()) {
+            // 本机构建使用宿主机上已安装的版本
+            std::string installed;
+            captureCommand("dpkg-query -W -f='${Package} ${Version} ${Architecture}\\n'" + names + " 2>/dev/null",
+                           installed);
+            std::istringstream stream(installed);
+            while (std::getline(stream, line)) {
+                if (!line.empty()) lines.push_back(line);
+            }
+        } else {
+            // 隔离构建的依赖在一次性上层中由 apt 安装，基础根目录的 dpkg 数据库里通常没有它们，
+            // 改用基础根目录的 apt 列表给出的候选版本；不写入 pkgcache，基础根目录保持不变
+            std::string policy;
+            captureCommand("apt-cache -o Dir=" + shellQuote(root)
+                           + " -o Dir::Cache::pkgcache= -o Dir::Cache::srcpkgcache= policy" + names + " 2>/dev/null",
+                           policy);
+            std::istringstream stream(policy);
+            std::string package;
+            while (std::getline(stream, line)) {
+                if (!line.empty() && line.back() == ':' && !std::isspace(static_cast<unsigned char>(line[0]))) {
+                    package = line.substr(0, line.size() - 1);
+                    continue;
+                }
+                std::istringstream fields(line);
+                std::string label, version;
+                if (!package.empty() && fields >> label >> version && label == "Candidate:" && version != "(none)") {
+                    lines.push_back(package + " " + version);
+                }
+            }
+        }
+
+        std::sort(lines.begin(), lines.end());
+        for (const auto& entry : lines) {
+            fingerprint << "depends " << entry << "\n";
+        }
+    }
+
+    // 隔离环境把输出目录作为本地 apt 源，宿主机上也可能安装了新构建的包，
+    // 重新构建的树内依赖必须使缓存键改变
+    for (const auto& [name, hash] : treeOutputs) {
+        fingerprint << "tree " << name << " " << (hash.empty() ? "-" : hash) << "\n";
+    }
+
+    std::string digest;
+    std::string cmd = "printf '%s' " + shellQuote(fingerprint.str()) + " | sha256sum";
+    if (!captureCommand(cmd, digest)) return "";
+    return build_utils::firstWord(digest);
+}
+
+bool ArtifactCache::download(const std::string& key, const std::string& name,
+                             const std::filesystem::path& target) const {
+    auto source = entryPath(key) + "/" + name;
+    if (isRemote()) {
+        std::string cmd = "curl -fsS -o " + shellQuote(target) + " " + shellQuote(source) + " 2>/dev/null";
+        return std::system(cmd.c_str()) == 0;
+    }
+
+    std::error_code ec;
+    std::filesystem::copy_file(source, target, std::filesystem::copy_options::overwrite_existing, ec);
+    return !ec;
+}
+
+bool ArtifactCache::upload(const std::string& key, const std::filesystem::path& file) const {
+    std::string cmd = "curl -fsS -T " + shellQuote(file) + " "
+                    + shellQuote(entryPath(key) + "/" + file.filename().string());
+    return std::system(cmd.c_str()) == 0;
+}
+
+bool ArtifactCache::fetch(const std::string& key,
+                          const std::filesystem::path& outputDir,
+                          std::filesystem::path& changesFile) const {
+    if (key.empty()) return false;
+
+    auto stageDir = outputDir / (".cache-" + key);
+    std::filesystem::remove_all(stageDir);
+    std::filesystem::create_directories(stageDir);
+
+    // MANIFEST 不存在即未命中
+    if (!download(key, "MANIFEST", stageDir / "MANIFEST")) {
+        std::filesystem::remove_all(stageDir);
+        return false;
+    }
+
+    // 每行格式: <sha256> <大小> <文件名>
+    std::vector<std::string> files;
+    bool valid = true;
+    std::ifstream manifest(stageDir / "MANIFEST");
+    std::string sha256, name;
+    std::uintmax_t size = 0;
+    while (manifest >> sha256 >> size >> name) {
+        auto target = stageDir / name;
+        if (name.find('/') != std::string::npos || !download(key, name, target)) {
+            valid = false;
+            break;
+        }
+
+        std::error_code ec;
+        if (std::filesystem::file_size(target, ec) != size || build_utils::fileSha256(target) != sha256) {
+            std::cerr << _("Warning: Checksum mismatch in artifact cache for") << " " << name << "\n";
+            // 本地缓存中损坏的缓存项直接删除，重新构建后会被替换
+            if (!isRemote()) {
+                std::filesystem::remove_all(entryPath(key), ec);
+            }
+            valid = false;
+            break;
+        }
+        files.push_back(name);
+    }
+
+    auto changes = std::find_if(files.begin(), files.end(), [](const std::string& file) {
+        return std::filesystem::path(file).extension() == ".changes";
+    });
+    if (!valid || changes == files.end()) {
+        std::filesystem::remove_all(stageDir);
+        return false;
+    }
+
+    // 全部校验通过后才放入输出目录
+    for (const auto& file : files) {
+        std::filesystem::rename(stageDir / file, outputDir / file);
+    }
+    changesFile = outputDir / *changes;
+    std::filesystem::remove_all(stageDir);
+    return true;
+}
+
+bool ArtifactCache::store(const std::string& key, const std::filesystem::path& changesFile) const {
+    if (key.empty()) return false;
+
+    std::vector<std::filesystem::path> files = { changesFile };
+    for (const auto& file : build_utils::changesFiles(changesFile)) {
+        files.push_back(file);
+    }
+
+    std::ostringstream manifest;
+    for (const auto& file : files) {
+        auto sha256 = build_utils::fileSha256(file);
+        if (sha256.empty()) {
+            std::cerr << _("Warning: Unable to read artifact") << ": " << file << "\n";
+            return false;
+        }
+        manifest << sha256 << " " << std::filesystem::file_size(file) << " "
+                 << file.filename().string() << "\n";
+    }
+
+    if (isRemote()) {
+        // MANIFEST 最后上传，其他主机不会看到不完整的缓存项
+        for (const auto& file : files) {
+            if (!upload(key, file)) return false;
+        }
+        // 并行构建和同一主机上的其他进程可能同时存储，临时目录必须唯一
+        std::string pattern = (std::filesystem::temp_directory_path() / "lingmo-cache-XXXXXX").string();
+        if (!mkdtemp(pattern.data())) {
+            std::cerr << _("Warning: Failed to store artifacts in cache") << ": " << pattern << "\n";
+            return false;
+        }
+        std::filesystem::path tmp = pattern;
+        std::ofstream(tmp / "MANIFEST") << manifest.str();
+        bool success = upload(key, tmp / "MANIFEST");
+        std::error_code ec;
+        std::filesystem::remove_all(tmp, ec);
+        return success;
+    }
+
+    // 先写入临时目录再整体改名，并发写入同一个键时只有一个会生效
+    std::filesystem::path entry = entryPath(key);
+    if (std::filesystem::exists(entry / "MANIFEST")) return true;
+
+    auto tmp = entry;
+    tmp += ".tmp-" + std::to_string(getpid());
+    try {
+        std::filesystem::remove_all(tmp);
+        std::filesystem::create_directories(tmp);
+        for (const auto& file : files) {
+            std::filesystem::copy_file(file, tmp / file.filename());
+        }
+        std::ofstream(tmp / "MANIFEST") << manifest.str();
+
+        std::error_code ec;
+        std::filesystem::rename(tmp, entry, ec);
+        if (ec) std::filesystem::remove_all(tmp);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << _("Warning: Failed to store artifacts in cache") << ": " << e.what() << "\n";
+        std::error_code ec;
+        std::filesystem::remove_all(tmp, ec);
+        return false;
+    }
+}
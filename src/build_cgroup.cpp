@@ -0,0 +1,186 @@
+#include "build_cgroup.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+std::filesystem::path BuildCgroup::s_parent;
+long BuildCgroup::s_memoryMaxMb = 0;
+int BuildCgroup::s_cpuWeight = 0;
+
+namespace {
+
+const std::filesystem::path kCgroupRoot = "/sys/fs/cgroup";
+
+// cgroup 文件的写入错误只有在 write 调用时才能得到，因此不使用 ofstream
+bool writeValue(const std::filesystem::path& file, const std::string& value) {
+    int fd = open(file.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = write(fd, value.c_str(), value.size()) == static_cast<ssize_t>(value.size());
+    close(fd);
+    return ok;
+}
+
+std::string readValue(const std::filesystem::path& file) {
+    std::ifstream in(file);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+}
+
+// 读取 "key value" 格式文件中的某个值
+std::uint64_t keyedValue(const std::filesystem::path& file, const std::string& key) {
+    std::istringstream lines(readValue(file));
+    std::string name;
+    std::uint64_t value;
+    while (lines >> name >> value) {
+        if (name == key) return value;
+    }
+    return 0;
+}
+
+// PSI 文件中 "some ... total=<微秒>" 的累计停顿时间
+double stallSeconds(const std::filesystem::path& file) {
+    std::istringstream lines(readValue(file));
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.compare(0, 5, "some ") != 0) continue;
+        auto pos = line.find("total=");
+        if (pos != std::string::npos) return std::stoull(line.substr(pos + 6)) / 1e6;
+    }
+    return 0;
+}
+
+} // namespace
+
+bool BuildCgroup::setup(long memoryMaxMb, int cpuWeight) {
+    if (!std::filesystem::exists(kCgroupRoot / "cgroup.controllers")) {
+        return false;
+    }
+
+    // /proc/self/cgroup 中 cgroup v2 的条目形如 "0::/user.slice/..."
+    std::ifstream self("/proc/self/cgroup");
+    std::string line;
+    std::filesystem::path parent;
+    while (std::getline(self, line)) {
+        if (line.compare(0, 3, "0::") == 0) {
+            parent = kCgroupRoot / std::filesystem::path(line.substr(3)).relative_path();
+        }
+    }
+    if (parent.empty()) return false;
+
+    const std::string controllers = "+memory +cpu +io";
+    if (!writeValue(parent / "cgroup.subtree_control", controllers)) {
+        // 非根 cgroup 中有进程时不能启用控制器（no internal processes 规则）。
+        // 只有本进程时把自己移到 supervisor 子组，这正是 systemd-run --scope 提供的委派环境
+        std::istringstream procs(readValue(parent / "cgroup.procs"));
+        std::string pid;
+        int others = 0;
+        while (procs >> pid) {
+            if (pid != std::to_string(getpid())) ++others;
+        }
+
+        // 还有其他进程时无论如何都无法启用控制器，不创建 supervisor
+        bool enabled = false;
+        int error = EBUSY;
+        if (others == 0) {
+            std::error_code ec;
+            bool created = std::filesystem::create_directory(parent / "supervisor", ec);
+            bool moved = !ec && writeValue(parent / "supervisor/cgroup.procs", "0");
+            enabled = moved && writeValue(parent / "cgroup.subtree_control", controllers);
+            error = ec ? ec.value() : errno;
+            if (!enabled) {
+                // 回到原来的 cgroup，并删除本次创建的 supervisor，不留下空的子组
+                if (moved) writeValue(parent / "cgroup.procs", "0");
+                if (created) rmdir((parent / "supervisor").c_str());
+            }
+        }
+        if (!enabled) {
+            // 没有要求限制资源时静默退回不使用 cgroup
+            if (memoryMaxMb <= 0 && cpuWeight <= 0) return false;
+            std::cerr << _("Warning: Unable to enable cgroup controllers in") << " " << parent << ": "
+                      << std::strerror(error) << "\n";
+            return false;
+        }
+    }
+
+    s_parent = parent;
+    s_memoryMaxMb = memoryMaxMb;
+    s_cpuWeight = cpuWeight;
+    return true;
+}
+
+BuildCgroup::BuildCgroup(const std::string& name) {
+    if (s_parent.empty()) return;
+
+    auto path = s_parent / ("lingmo-pkgbuild-" + std::to_string(getpid()) + "-" + name);
+    std::error_code ec;
+    std::filesystem::create_directory(path, ec);
+    if (ec) {
+        std::cerr << _("Warning: Unable to create cgroup") << " " << path << ": " << ec.message() << "\n";
+        return;
+    }
+
+    // 超出 memory.max 时只有该构建被 OOM 终止，不会拖垮其他构建
+    if (s_memoryMaxMb > 0 && !writeValue(path / "memory.max", std::to_string(s_memoryMaxMb * 1024 * 1024))) {
+        std::cerr << _("Warning: Unable to set memory.max for") << " " << name << "\n";
+    }
+    if (s_cpuWeight > 0 && !writeValue(path / "cpu.weight", std::to_string(s_cpuWeight))) {
+        std::cerr << _("Warning: Unable to set cpu.weight for") << " " << name << "\n";
+    }
+    m_path = path;
+}
+
+BuildCgroup::~BuildCgroup() {
+    if (m_path.empty()) return;
+
+    // 测试套件可能留下后台进程，cgroup.kill 会一次结束整个子树，旧内核上逐个结束
+    std::string procs = readValue(m_path / "cgroup.procs");
+    if (!procs.empty() && !writeValue(m_path / "cgroup.kill", "1")) {
+        std::istringstream pids(procs);
+        pid_t pid;
+        while (pids >> pid) {
+            kill(pid, SIGKILL);
+        }
+    }
+    for (int i = 0; i < 50; ++i) {
+        if (rmdir(m_path.c_str()) == 0 || errno != EBUSY) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    std::cerr << _("Warning: Unable to remove cgroup") << " " << m_path << "\n";
+}
+
+void BuildCgroup::collect(BuildUsage& usage) const {
+    if (m_path.empty()) return;
+
+    usage.hasCgroupStats = true;
+    usage.cpuSeconds = keyedValue(m_path / "cpu.stat", "usage_usec") / 1e6;
+
+    // memory.peak 统计整个进程树，比单个进程的 ru_maxrss 更适合作为并发构建的内存预算
+    std::string peak = readValue(m_path / "memory.peak");
+    if (!peak.empty() && std::isdigit(static_cast<unsigned char>(peak[0]))) {
+        usage.peakRssKb = static_cast<long>(std::stoull(peak) / 1024);
+    }
+
+    // io.stat 每行一个设备: "<主:次> rbytes=... wbytes=... rios=... ..."
+    std::istringstream io(readValue(m_path / "io.stat"));
+    std::string token;
+    while (io >> token) {
+        if (token.compare(0, 7, "rbytes=") == 0) usage.ioReadBytes += std::stoull(token.substr(7));
+        if (token.compare(0, 7, "wbytes=") == 0) usage.ioWriteBytes += std::stoull(token.substr(7));
+    }
+
+    usage.cpuStallSeconds = stallSeconds(m_path / "cpu.pressure");
+    usage.memoryStallSeconds = stallSeconds(m_path / "memory.pressure");
+    usage.ioStallSeconds = stallSeconds(m_path / "io.pressure");
+    usage.oomKilled = keyedValue(m_path / "memory.events", "oom_kill") > 0;
+}
@@ -0,0 +1,122 @@
+#include "build_env.h"
+#include "build_utils.h"
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <libintl.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#define _(str) gettext(str)
+
+using build_utils::shellQuote;
+
+IsolatedBuildEnv::IsolatedBuildEnv(const std::filesystem::path& baseRoot,
+                                   const std::filesystem::path& buildDir,
+                                   const std::filesystem::path& localRepo)
+    : m_baseRoot(std::filesystem::absolute(baseRoot)),
+      m_buildDir(std::filesystem::absolute(buildDir)),
+      m_localRepo(std::filesystem::absolute(localRepo)) {
+}
+
+std::filesystem::path IsolatedBuildEnv::envDir(const std::string& name) const {
+    return m_buildDir / "envs" / name;
+}
+
+bool IsolatedBuildEnv::validateBaseRoot(const std::filesystem::path& baseRoot) {
+    if (!std::filesystem::exists(baseRoot / "usr/bin/apt-get") ||
+        !std::filesystem::exists(baseRoot / "usr/bin/dpkg-buildpackage")) {
+        std::cerr << _("Error: Base root must contain apt and dpkg-dev") << ": " << baseRoot << "\n";
+        return false;
+    }
+    return true;
+}
+
+std::string IsolatedBuildEnv::wrap(const std::string& name, const std::string& cmd) const {
+    auto dir = envDir(name);
+    discard(name);
+    std::filesystem::create_directories(dir / "upper");
+    std::filesystem::create_directories(dir / "work");
+    std::filesystem::create_directories(dir / "root");
+    std::filesystem::create_directories(dir / "archives/partial");
+    std::filesystem::create_directories(m_buildDir / kAptCacheDir);
+
+    // 每个环境使用自己的 archives 目录，并行构建不会争用 apt 的锁和下载中的文件；
+    // 共享缓存中已有的包以硬链接提供，discard 时再把新下载的包链接回去
+    for (const auto& entry : std::filesystem::directory_iterator(m_buildDir / kAptCacheDir)) {
+        if (entry.path().extension() != ".deb") continue;
+        std::error_code ec;
+        std::filesystem::create_hard_link(entry.path(), dir / "archives" / entry.path().filename(), ec);
+    }
+
+    auto root = dir / "root";
+    std::string rootQ = shellQuote(root);
+    std::filesystem::create_directories(m_localRepo);
+    std::string repoInRoot = root.string() + m_localRepo.string();
+
+    // 先把输出目录中已构建的包索引为只对本环境可见的本地源
+    std::string listFile = "/etc/apt/sources.list.d/lingmo-local.list";
+    std::string innerCmd = "mkdir -p /lingmo-local && cd /lingmo-local && ln -sfn " + shellQuote(m_localRepo) + " pool"
+                         + " && dpkg-scanpackages pool > Packages 2>/dev/null"
+                         + " && echo 'deb [trusted=yes] file:/lingmo-local ./' > " + listFile
+                         + " && apt-get -qq -o Dir::Etc::SourceList=" + listFile
+                         + " -o Dir::Etc::SourceParts=- -o APT::Get::List-Cleanup=0 update"
+                         + " && " + cmd;
+
+    // 挂载只存在于新的 mount 命名空间中，命令结束后随命名空间一起消失
+    std::ofstream script(dir / "run.sh");
+    script << "set -e\n"
+           << "mount -t overlay overlay -o " << shellQuote("lowerdir=" + m_baseRoot.string()
+                  + ",upperdir=" + (dir / "upper").string() + ",workdir=" + (dir / "work").string())
+           << " " << rootQ << "\n"
+           << "mount -t proc proc " << rootQ << "/proc\n"
+           << "mount --rbind /dev " << rootQ << "/dev\n"
+           << "mkdir -p " << shellQuote(root.string() + m_buildDir.string()) << " " << rootQ << "/var/cache/apt/archives\n"
+           << "mount --bind " << shellQuote(m_buildDir) << " " << shellQuote(root.string() + m_buildDir.string()) << "\n"
+           << "mount --bind " << shellQuote(dir / "archives") << " " << rootQ << "/var/cache/apt/archives\n"
+           << "mkdir -p " << shellQuote(repoInRoot) << "\n"
+           << "mount --bind -o ro " << shellQuote(m_localRepo) << " " << shellQuote(repoInRoot) << "\n"
+           << "cp /etc/resolv.conf " << rootQ << "/etc/resolv.conf 2>/dev/null || true\n"
+           << "exec chroot " << rootQ << " /usr/bin/env -i PATH=/usr/sbin:/usr/bin:/sbin:/bin HOME=/root"
+           << " DEBIAN_FRONTEND=noninteractive /bin/sh -c " << shellQuote(innerCmd) << "\n";
+
+    // 非 root 用户通过 user 命名空间映射为 root，宿主机上不需要任何特权
+    std::string unshare = "unshare --mount --pid --fork";
+#ifdef HAVE_UNISTD_H
+    if (geteuid() != 0) {
+        unshare = "unshare --user --map-root-user --mount --pid --fork";
+    }
+#endif
+    return unshare + " /bin/sh " + shellQuote(dir / "run.sh");
+}
+
+void IsolatedBuildEnv::discard(const std::string& name) const {
+    auto dir = envDir(name);
+    if (!std::filesystem::exists(dir)) return;
+
+    // apt 下载完成后才把包改名到 archives 中，这里的 deb 都是完整的；
+    // 共享缓存中已有同名文件时保留原文件
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(dir / "archives", ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() != ".deb") continue;
+        auto cached = m_buildDir / kAptCacheDir / it->path().filename();
+        std::error_code linkError;
+        std::filesystem::create_hard_link(it->path(), cached, linkError);
+        if (linkError && linkError != std::errc::file_exists) {
+            // 无法硬链接时先复制到本环境独有的临时文件再改名，其他环境不会读到不完整的包
+            auto tmp = cached;
+            tmp += "." + name + ".new";
+            if (std::filesystem::copy_file(it->path(), tmp, std::filesystem::copy_options::overwrite_existing, linkError)) {
+                std::filesystem::rename(tmp, cached, linkError);
+            }
+            if (linkError) std::filesystem::remove(tmp, linkError);
+        }
+    }
+
+    // overlayfs 的 workdir 权限为 000，先恢复权限再删除
+    std::string cmd = "chmod -R u+rwX " + shellQuote(dir) + " 2>/dev/null; rm -rf " + shellQuote(dir);
+    if (std::system(cmd.c_str()) != 0) {
+        std::cerr << _("Warning: Unable to remove build environment") << ": " << dir << "\n";
+    }
+}
@@ -0,0 +1,24 @@
+#include "build_handle.h"
+#include <csignal>
+#include <sys/types.h>
+
+const char* buildPhaseName(BuildPhase phase) {
+    switch (phase) {
+    case BuildPhase::Stage: return "stage";
+    case BuildPhase::OrigTarball: return "orig-tarball";
+    case BuildPhase::Build: return "build";
+    case BuildPhase::Sign: return "sign";
+    case BuildPhase::Collect: return "collect";
+    case BuildPhase::Assemble: return "assemble";
+    }
+    return "unknown";
+}
+
+void BuildControl::cancel() {
+    cancelled = true;
+    // 命令在独立的进程组中运行，向整个组发信号以结束其所有子进程
+    long group = processGroup.load();
+    if (group > 0) {
+        kill(-static_cast<pid_t>(group), SIGTERM);
+    }
+}
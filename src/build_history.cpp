@@ -0,0 +1,56 @@
+#include "build_history.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <ctime>
+
+BuildHistory::BuildHistory(const std::filesystem::path& file) : m_file(file) {
+    // 每行格式: 包名 \t 耗时 \t CPU 时间 \t 峰值内存(KB) \t 结果 \t 时间戳
+    std::ifstream in(m_file);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string package, result;
+        BuildUsage usage;
+        if (!(fields >> package >> usage.wallSeconds >> usage.cpuSeconds >> usage.peakRssKb >> result)) {
+            continue;
+        }
+        if (result == "ok") {
+            m_samples[package].push_back(usage);
+        }
+    }
+}
+
+void BuildHistory::record(const std::string& package, const BuildUsage& usage, bool success) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (success) {
+        m_samples[package].push_back(usage);
+    }
+
+    std::filesystem::create_directories(m_file.parent_path());
+    std::ofstream out(m_file, std::ios::app);
+    out << package << "\t" << usage.wallSeconds << "\t" << usage.cpuSeconds << "\t"
+        << usage.peakRssKb << "\t" << (success ? "ok" : "failed") << "\t"
+        << std::time(nullptr) << "\n";
+}
+
+bool BuildHistory::estimate(const std::string& package, BuildUsage& usage) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_samples.find(package);
+    if (it == m_samples.end() || it->second.empty()) {
+        return false;
+    }
+
+    // 耗时取平均，内存取最大值，避免低估内存占用
+    const auto& samples = it->second;
+    size_t first = samples.size() > kSamples ? samples.size() - kSamples : 0;
+    usage = BuildUsage{};
+    for (size_t i = first; i < samples.size(); ++i) {
+        usage.wallSeconds += samples[i].wallSeconds;
+        usage.cpuSeconds += samples[i].cpuSeconds;
+        usage.peakRssKb = std::max(usage.peakRssKb, samples[i].peakRssKb);
+    }
+    usage.wallSeconds /= samples.size() - first;
+    usage.cpuSeconds /= samples.size() - first;
+    return true;
+}
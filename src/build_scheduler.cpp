@@ -0,0 +1,322 @@
+#include "build_scheduler.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+namespace {
+
+std::string trim(const std::string& value) {
+    auto begin = value.find_first_not_of(" \t\n");
+    if (begin == std::string::npos) return "";
+    auto end = value.find_last_not_of(" \t\n");
+    return value.substr(begin, end - begin + 1);
+}
+
+// 把 Build-Depends 字段拆分为包名列表，忽略版本、架构限定和可选项
+void splitDependencies(const std::string& field, std::vector<std::string>& names) {
+    std::stringstream clauses(field);
+    std::string clause;
+    while (std::getline(clauses, clause, ',')) {
+        std::stringstream alternatives(clause);
+        std::string alternative;
+        while (std::getline(alternatives, alternative, '|')) {
+            alternative = trim(alternative);
+            auto end = alternative.find_first_of(" \t([<:");
+            auto name = alternative.substr(0, end);
+            if (!name.empty()) names.push_back(name);
+        }
+    }
+}
+
+std::string formatDuration(double seconds) {
+    long total = static_cast<long>(seconds + 0.5);
+    std::ostringstream out;
+    out << total / 3600 << ":" << std::setw(2) << std::setfill('0') << (total / 60) % 60
+        << ":" << std::setw(2) << std::setfill('0') << total % 60;
+    return out.str();
+}
+
+} // namespace
+
+BuildScheduler::BuildScheduler(const std::vector<std::filesystem::path>& packageDirs,
+                               const BuildHistory& history) {
+    std::vector<std::vector<std::string>> buildDepends;
+    for (const auto& dir : packageDirs) {
+        Package package;
+        package.dir = dir;
+        package.name = dir.filename().string();
+
+        std::vector<std::string> deps;
+        parseControl(package, deps);
+        package.buildDepends = deps;
+        package.hasHistory = history.estimate(package.name, package.estimate);
+
+        m_packages.push_back(package);
+        buildDepends.push_back(deps);
+    }
+
+    // 没有历史记录的包按已知包的平均耗时估算
+    double knownTotal = 0;
+    size_t known = 0;
+    for (const auto& package : m_packages) {
+        if (package.hasHistory) {
+            knownTotal += package.estimate.wallSeconds;
+            ++known;
+        }
+    }
+    double fallback = known ? knownTotal / known : kDefaultWallSeconds;
+    for (auto& package : m_packages) {
+        if (!package.hasHistory) package.estimate.wallSeconds = fallback;
+    }
+
+    resolveDependencies(buildDepends);
+    computePriorities();
+}
+
+void BuildScheduler::parseControl(Package& package, std::vector<std::string>& buildDepends) {
+    std::ifstream control(package.dir / "debian/control");
+    std::string line;
+    std::string field;
+    std::map<std::string, std::string> depends;
+
+    while (std::getline(control, line)) {
+        if (line.empty() || line[0] == '#') {
+            field.clear();
+            continue;
+        }
+        if (std::isspace(static_cast<unsigned char>(line[0]))) {
+            if (!field.empty()) depends[field] += " " + line;
+            continue;
+        }
+
+        auto colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string key = line.substr(0, colon);
+        std::string value = trim(line.substr(colon + 1));
+        field.clear();
+
+        if (key == "Source") {
+            package.name = value;
+        } else if (key == "Package") {
+            package.binaries.push_back(value);
+        } else if (key == "Build-Depends" || key == "Build-Depends-Indep" || key == "Build-Depends-Arch") {
+            field = key;
+            depends[key] = value;
+        }
+    }
+
+    for (const auto& [key, value] : depends) {
+        splitDependencies(value, buildDepends);
+    }
+}
+
+void BuildScheduler::resolveDependencies(const std::vector<std::vector<std::string>>& buildDepends) {
+    std::map<std::string, size_t> provider;
+    for (size_t i = 0; i < m_packages.size(); ++i) {
+        for (const auto& binary : m_packages[i].binaries) {
+            provider[binary] = i;
+        }
+    }
+
+    for (size_t i = 0; i < m_packages.size(); ++i) {
+        for (const auto& name : buildDepends[i]) {
+            auto it = provider.find(name);
+            if (it == provider.end() || it->second == i) continue;
+            auto& deps = m_packages[i].dependencies;
+            if (std::find(deps.begin(), deps.end(), it->second) == deps.end()) {
+                deps.push_back(it->second);
+            }
+        }
+    }
+
+    // 深度优先搜索去掉形成环的依赖边，保证调度一定能推进
+    std::vector<int> state(m_packages.size(), 0);  // 0 未访问, 1 访问中, 2 完成
+    std::function<void(size_t)> visit = [&](size_t i) {
+        state[i] = 1;
+        auto& deps = m_packages[i].dependencies;
+        for (auto it = deps.begin(); it != deps.end();) {
+            if (state[*it] == 1) {
+                std::cerr << _("Warning: Ignoring build dependency cycle between") << " "
+                          << m_packages[i].name << " -> " << m_packages[*it].name << "\n";
+                it = deps.erase(it);
+                continue;
+            }
+            if (state[*it] == 0) visit(*it);
+            ++it;
+        }
+        state[i] = 2;
+    };
+    for (size_t i = 0; i < m_packages.size(); ++i) {
+        if (state[i] == 0) visit(i);
+    }
+
+    for (size_t i = 0; i < m_packages.size(); ++i) {
+        for (size_t dep : m_packages[i].dependencies) {
+            m_packages[dep].dependents.push_back(i);
+        }
+    }
+}
+
+void BuildScheduler::computePriorities() {
+    // 关键路径长度 = 自身耗时 + 最长的下游路径
+    std::vector<bool> done(m_packages.size(), false);
+    std::function<double(size_t)> priority = [&](size_t i) -> double {
+        if (done[i]) return m_packages[i].priority;
+        double longest = 0;
+        for (size_t dependent : m_packages[i].dependents) {
+            longest = std::max(longest, priority(dependent));
+        }
+        m_packages[i].priority = m_packages[i].estimate.wallSeconds + longest;
+        done[i] = true;
+        return m_packages[i].priority;
+    };
+    for (size_t i = 0; i < m_packages.size(); ++i) {
+        priority(i);
+    }
+}
+
+int BuildScheduler::pickNext(const std::vector<size_t>& ready, long memoryInUse,
+                             long memoryLimitKb, bool idle) const {
+    int best = -1;
+    int fallback = -1;
+    for (size_t i : ready) {
+        const auto& package = m_packages[i];
+        if (fallback < 0 || package.priority > m_packages[fallback].priority) {
+            fallback = static_cast<int>(i);
+        }
+        bool fits = memoryLimitKb <= 0 || memoryInUse + package.estimate.peakRssKb <= memoryLimitKb;
+        if (fits && (best < 0 || package.priority > m_packages[best].priority)) {
+            best = static_cast<int>(i);
+        }
+    }
+    // 没有任何构建在运行时，即使超出内存预算也必须启动一个
+    return best >= 0 ? best : (idle ? fallback : -1);
+}
+
+void BuildScheduler::printPlan(int workers, long memoryLimitKb) const {
+    struct Slot { double start; double end; };
+    std::vector<Slot> slots(m_packages.size());
+    std::vector<size_t> remaining(m_packages.size());
+    std::vector<size_t> ready;
+    for (size_t i = 0; i < m_packages.size(); ++i) {
+        remaining[i] = m_packages[i].dependencies.size();
+        if (remaining[i] == 0) ready.push_back(i);
+    }
+
+    std::vector<std::pair<double, size_t>> running;  // (结束时间, 包)
+    std::vector<size_t> order;
+    double now = 0;
+    long memoryInUse = 0;
+    while (order.size() < m_packages.size()) {
+        while (static_cast<int>(running.size()) < workers) {
+            int next = pickNext(ready, memoryInUse, memoryLimitKb, running.empty());
+            if (next < 0) break;
+            ready.erase(std::find(ready.begin(), ready.end(), static_cast<size_t>(next)));
+            slots[next] = { now, now + m_packages[next].estimate.wallSeconds };
+            memoryInUse += m_packages[next].estimate.peakRssKb;
+            running.emplace_back(slots[next].end, next);
+            order.push_back(next);
+        }
+        if (running.empty()) break;
+
+        auto first = std::min_element(running.begin(), running.end());
+        now = first->first;
+        size_t finished = first->second;
+        running.erase(first);
+        memoryInUse -= m_packages[finished].estimate.peakRssKb;
+        for (size_t dependent : m_packages[finished].dependents) {
+            if (--remaining[dependent] == 0) ready.push_back(dependent);
+        }
+    }
+
+    double makespan = 0;
+    std::cout << _("Predicted build schedule") << ":\n";
+    for (size_t i : order) {
+        const auto& package = m_packages[i];
+        std::cout << "  " << formatDuration(slots[i].start) << " - " << formatDuration(slots[i].end)
+                  << "  " << package.name
+                  << (package.hasHistory ? "" : std::string(" (") + _("no history") + ")");
+        if (package.estimate.peakRssKb > 0) {
+            std::cout << "  " << package.estimate.peakRssKb / 1024 << " MB";
+        }
+        std::cout << "\n";
+        makespan = std::max(makespan, slots[i].end);
+    }
+    std::cout << _("Predicted makespan") << ": " << formatDuration(makespan) << "\n";
+}
+
+bool BuildScheduler::run(int workers, long memoryLimitKb, const std::function<bool(const Package&)>& build) {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<size_t> finished;
+    std::vector<bool> results(m_packages.size(), false);
+    std::vector<std::thread> threads;
+
+    std::vector<size_t> remaining(m_packages.size());
+    std::vector<size_t> ready;
+    for (size_t i = 0; i < m_packages.size(); ++i) {
+        remaining[i] = m_packages[i].dependencies.size();
+        if (remaining[i] == 0) ready.push_back(i);
+    }
+
+    size_t done = 0;
+    int running = 0;
+    long memoryInUse = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (done < m_packages.size()) {
+        while (running < workers) {
+            int next = pickNext(ready, memoryInUse, memoryLimitKb, running == 0);
+            if (next < 0) break;
+            ready.erase(std::find(ready.begin(), ready.end(), static_cast<size_t>(next)));
+            memoryInUse += m_packages[next].estimate.peakRssKb;
+            ++running;
+
+            threads.emplace_back([&, next]() {
+                bool ok = build(m_packages[next]);
+                std::lock_guard<std::mutex> guard(mutex);
+                results[next] = ok;
+                finished.push_back(next);
+                cond.notify_one();
+            });
+        }
+        if (running == 0) break;
+
+        cond.wait(lock, [&]() { return !finished.empty(); });
+        for (size_t i : finished) {
+            --running;
+            ++done;
+            memoryInUse -= m_packages[i].estimate.peakRssKb;
+            // 依赖构建失败时仍继续构建下游包，与顺序构建时的行为一致
+            for (size_t dependent : m_packages[i].dependents) {
+                if (--remaining[dependent] == 0) ready.push_back(dependent);
+            }
+        }
+        finished.clear();
+    }
+    lock.unlock();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return std::all_of(results.begin(), results.end(), [](bool ok) { return ok; });
+}
+
+long BuildScheduler::systemMemoryKb() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    long value = 0;
+    std::string unit;
+    while (meminfo >> key >> value >> unit) {
+        if (key == "MemTotal:") return value;
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+
+// 构建工具内部使用的辅助函数
+namespace build_utils {
+
+inline std::string shellQuote(const std::string& value) {
+    std::string quoted = "'";
+    for (char c : value) {
+        if (c == '\'') quoted += "'\\''";
+        else quoted += c;
+    }
+    return quoted + "'";
+}
+
+inline std::string shellQuote(const std::filesystem::path& path) {
+    return shellQuote(path.string());
+}
+
+// 执行命令并读取标准输出，命令返回非零时返回 false
+inline bool captureCommand(const std::string& cmd, std::string& output) {
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (!pipe) return false;
+
+    output.clear();
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+        output.append(buffer, n);
+    }
+    return pclose(pipe) == 0;
+}
+
+inline std::string firstWord(const std::string& text) {
+    return text.substr(0, text.find_first_of(" \t\n"));
+}
+
+// 计算文件的 SHA256，失败时返回空字符串
+inline std::string fileSha256(const std::filesystem::path& file) {
+    std::string output;
+    if (!captureCommand("sha256sum " + shellQuote(file), output)) return "";
+    return firstWord(output);
+}
+
+using Stanza = std::vector<std::pair<std::string, std::string>>;
+
+// 读取 deb822 格式文件中的所有段落，续行以换行符连接并保留行首空白
+inline std::vector<Stanza> readStanzas(const std::filesystem::path& file) {
+    std::vector<Stanza> stanzas;
+    std::ifstream in(file);
+    std::string line;
+    bool newStanza = true;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line[0] == '#') continue;
+        if (line.find_first_not_of(" \t") == std::string::npos) {
+            newStanza = true;
+            continue;
+        }
+        if (std::isspace(static_cast<unsigned char>(line[0]))) {
+            if (!stanzas.empty() && !stanzas.back().empty()) {
+                stanzas.back().back().second += "\n" + line;
+            }
+            continue;
+        }
+
+        auto colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        if (newStanza) {
+            stanzas.emplace_back();
+            newStanza = false;
+        }
+        auto value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        stanzas.back().emplace_back(line.substr(0, colon), value);
+    }
+    return stanzas;
+}
+
+inline std::string fieldValue(const Stanza& stanza, const std::string& key) {
+    for (const auto& [name, value] : stanza) {
+        if (name == key) return value;
+    }
+    return "";
+}
+
+// changes 文件 Files 字段列出的全部文件（不含 changes 本身），位于 changes 所在目录。
+// 签名的 changes 在正文前还有 "Hash:" 段落，因此查找含有 Files 字段的段落
+inline std::vector<std::filesystem::path> changesFiles(const std::filesystem::path& changesFile) {
+    std::vector<std::filesystem::path> files;
+    for (const auto& stanza : readStanzas(changesFile)) {
+        // 每行为 "md5 size section priority name"
+        std::istringstream lines(fieldValue(stanza, "Files"));
+        std::string line;
+        while (std::getline(lines, line)) {
+            std::istringstream fields(line);
+            std::string md5, size, section, priority, name;
+            if (fields >> md5 >> size >> section >> priority >> name) {
+                files.push_back(changesFile.parent_path() / name);
+            }
+        }
+    }
+    return files;
+}
+
+} // namespace build_utils
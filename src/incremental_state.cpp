@@ -0,0 +1,274 @@
+#include "incremental_state.h"
+#include "build_utils.h"
+#include "source_stager.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <thread>
+#include <functional>
+#include <set>
+#include <cctype>
+#include <unistd.h>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+using build_utils::shellQuote;
+using build_utils::captureCommand;
+using build_utils::firstWord;
+
+namespace {
+
+bool isRelationField(const std::string& key) {
+    static const std::set<std::string> kFields = {
+        "Depends", "Pre-Depends", "Recommends", "Suggests", "Enhances",
+        "Breaks", "Conflicts", "Replaces", "Provides",
+    };
+    return kFields.count(key) > 0;
+}
+
+// 指向同一源码包中其他二进制包的版本约束 (如 -dev 包的 (= ${binary:Version}))
+// 随每次构建的版本号变化，只保留运算符，版本替换为 *
+std::string normalizeRelations(const std::string& value, const std::set<std::string>& siblings) {
+    std::string result;
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t end = value.find_first_of(",|", start);
+        if (end == std::string::npos) end = value.size();
+
+        std::string term = value.substr(start, end - start);
+        auto first = term.find_first_not_of(" \t\n");
+        if (first != std::string::npos) {
+            auto nameEnd = term.find_first_of(" \t\n(:[", first);
+            std::string name = term.substr(first, nameEnd == std::string::npos ? std::string::npos : nameEnd - first);
+            auto open = term.find('(');
+            auto close = open == std::string::npos ? std::string::npos : term.find(')', open);
+            if (siblings.count(name) && close != std::string::npos) {
+                std::string op;
+                for (size_t i = open + 1; i < close && std::string("<>= \t").find(term[i]) != std::string::npos; ++i) {
+                    if (!std::isspace(static_cast<unsigned char>(term[i]))) op += term[i];
+                }
+                term = term.substr(0, open + 1) + op + " *" + term.substr(close);
+            }
+        }
+
+        result += term;
+        if (end < value.size()) result += value[end];
+        start = end + 1;
+    }
+    return result;
+}
+
+} // namespace
+
+IncrementalState::IncrementalState(const std::filesystem::path& buildDir, const std::filesystem::path& outputDir)
+    : m_stateDir(buildDir / kDirName), m_outputDir(outputDir) {
+}
+
+bool IncrementalState::load(const std::string& package, State& state) const {
+    // 每行格式: source <哈希> | output <哈希> | dep <包名> <哈希> | artifact <文件名>
+    std::ifstream in(m_stateDir / (package + ".state"));
+    if (!in.is_open()) return false;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string key, value, extra;
+        fields >> key >> value;
+        if (key == "source") {
+            state.source = value;
+        } else if (key == "output") {
+            state.output = value;
+        } else if (key == "dep" && fields >> extra) {
+            state.dependencies[value] = extra;
+        } else if (key == "artifact") {
+            state.artifacts.push_back(value);
+        }
+    }
+    return !state.source.empty() && !state.output.empty();
+}
+
+bool IncrementalState::save(const std::string& package, const State& state) const {
+    std::filesystem::create_directories(m_stateDir);
+    auto file = m_stateDir / (package + ".state");
+    auto tmp = file;
+    tmp += ".new";
+    {
+        std::ofstream out(tmp);
+        if (!out.is_open()) return false;
+        out << "source " << state.source << "\n"
+            << "output " << state.output << "\n";
+        for (const auto& [name, hash] : state.dependencies) {
+            out << "dep " << name << " " << hash << "\n";
+        }
+        for (const auto& artifact : state.artifacts) {
+            out << "artifact " << artifact << "\n";
+        }
+    }
+    std::filesystem::rename(tmp, file);
+    return true;
+}
+
+std::string IncrementalState::hashSource(const std::filesystem::path& sourceDir) {
+    // 只对会被暂存的文件计算哈希，被忽略的文件变化不会触发重新构建
+    auto list = std::filesystem::temp_directory_path() / ("lingmo-source-" + std::to_string(getpid()) + "-"
+              + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".list");
+    {
+        std::ofstream out(list, std::ios::binary);
+        if (!out.is_open()) return "";
+        for (const auto& entry : SourceStager::listFiles(sourceDir)) {
+            if (std::filesystem::is_regular_file(std::filesystem::symlink_status(sourceDir / entry))) {
+                out << "./" << entry.generic_string() << '\0';
+            }
+        }
+    }
+
+    std::string output;
+    std::string cmd = "cd " + shellQuote(sourceDir) + " && "
+                    + "xargs -0r -a " + shellQuote(list) + " sha256sum | sha256sum";
+    bool success = captureCommand(cmd, output);
+    std::filesystem::remove(list);
+    if (!success) return "";
+    return firstWord(output);
+}
+
+bool IncrementalState::hashOutput(const std::string& package,
+                                  const std::vector<std::filesystem::path>& debs,
+                                  std::string& hash) const {
+    auto workDir = m_stateDir / (package + ".tmp");
+    auto manifest = m_stateDir / (package + ".manifest");
+    std::ofstream out(manifest);
+    if (!out.is_open()) return false;
+
+    // 同一源码包构建出的所有二进制包
+    std::set<std::string> siblings;
+    for (const auto& deb : debs) {
+        std::string name;
+        if (captureCommand("dpkg-deb -f " + shellQuote(deb.string()) + " Package", name)) {
+            siblings.insert(firstWord(name));
+        }
+    }
+
+    bool success = true;
+    for (const auto& deb : debs) {
+        std::filesystem::remove_all(workDir);
+        std::filesystem::create_directories(workDir);
+
+        std::string cmd = "dpkg-deb -x " + shellQuote(deb.string()) + " " + shellQuote((workDir / "data").string())
+                        + " && dpkg-deb -e " + shellQuote(deb.string()) + " " + shellQuote((workDir / "control").string());
+        if (std::system(cmd.c_str()) != 0) {
+            std::cerr << _("Error: Failed to unpack") << " " << deb << "\n";
+            success = false;
+            break;
+        }
+
+        // 版本号和安装大小随每次构建变化，但不影响依赖它的包能看到的内容；
+        // 关系字段按完整的字段值 (含续行) 规范化后再写入
+        std::ifstream control(workDir / "control/control");
+        std::string line;
+        std::string key;
+        std::string value;
+        auto flushField = [&]() {
+            if (key.empty() || key == "Version" || key == "Installed-Size" || key == "Source") return;
+            out << "control " << key << ":"
+                << (isRelationField(key) ? normalizeRelations(value, siblings) : value) << "\n";
+        };
+        while (std::getline(control, line)) {
+            if (!line.empty() && !std::isspace(static_cast<unsigned char>(line[0]))) {
+                flushField();
+                auto colon = line.find(':');
+                key = line.substr(0, colon);
+                value = colon == std::string::npos ? "" : line.substr(colon + 1);
+            } else {
+                value += "\n" + line;
+            }
+        }
+        flushField();
+
+        std::string listing;
+        cmd = "cd " + shellQuote((workDir / "control").string()) + " && "
+            + "find . -type f ! -name control ! -name md5sums -print0 | LC_ALL=C sort -z | xargs -0r sha256sum"
+            + " && cd ../data && find . -path ./usr/share/doc -prune -o -printf '%m %y %p %l\\n' | LC_ALL=C sort"
+            + " && find . -path ./usr/share/doc -prune -o -type f -print0 | LC_ALL=C sort -z | xargs -0r sha256sum";
+        if (!captureCommand(cmd, listing)) {
+            success = false;
+            break;
+        }
+        out << listing;
+    }
+    out.close();
+    std::filesystem::remove_all(workDir);
+
+    if (!success) return false;
+    hash = build_utils::fileSha256(manifest);
+    return !hash.empty();
+}
+
+bool IncrementalState::upToDate(const std::string& package,
+                                const std::vector<std::string>& dependencies,
+                                const std::string& sourceHash) const {
+    State state;
+    if (sourceHash.empty() || !load(package, state) || state.source != sourceHash) {
+        return false;
+    }
+    if (state.dependencies.size() != dependencies.size()) {
+        return false;
+    }
+
+    // 依赖包即使重新构建过，只要产物内容哈希与上次构建时相同就不影响本包
+    for (const auto& dependency : dependencies) {
+        State depState;
+        auto it = state.dependencies.find(dependency);
+        if (it == state.dependencies.end() || !load(dependency, depState) || depState.output != it->second) {
+            return false;
+        }
+    }
+
+    for (const auto& artifact : state.artifacts) {
+        if (!std::filesystem::exists(m_outputDir / artifact)) return false;
+    }
+    return true;
+}
+
+std::string IncrementalState::outputHash(const std::string& package) const {
+    State state;
+    return load(package, state) ? state.output : "";
+}
+
+bool IncrementalState::record(const std::string& package,
+                              const std::string& sourceHash,
+                              const std::vector<std::string>& dependencies,
+                              const std::filesystem::path& changesFile) const {
+    State state;
+    state.source = sourceHash;
+    state.artifacts.push_back(changesFile.filename().string());
+
+    std::vector<std::filesystem::path> debs;
+    for (const auto& file : build_utils::changesFiles(changesFile)) {
+        state.artifacts.push_back(file.filename().string());
+        if (file.extension() == ".deb" || file.extension() == ".udeb") {
+            debs.push_back(file);
+        }
+    }
+
+    std::filesystem::create_directories(m_stateDir);
+    if (!hashOutput(package, debs, state.output)) {
+        std::cerr << _("Warning: Unable to hash build output of") << " " << package << "\n";
+        return false;
+    }
+
+    for (const auto& dependency : dependencies) {
+        State depState;
+        if (load(dependency, depState)) {
+            state.dependencies[dependency] = depState.output;
+        }
+    }
+
+    State previous;
+    if (load(package, previous) && previous.output == state.output) {
+        std::cout << _("Output of") << " " << package << " "
+                  << _("is unchanged, dependents will not be rebuilt") << "\n";
+    }
+    return save(package, state);
+}
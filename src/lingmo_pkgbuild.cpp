@@ -1,23 +1,154 @@
 #include "lingmo_pkgbuild.h"
+#include "build_cgroup.h"
+#include "build_utils.h"
+#include "source_stager.h"
+#include "source_cache.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <chrono>
 #include <cstdlib>
+#include <cerrno>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <cctype>
+#include <cstdio>
 #include <libintl.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <poll.h>
+#include <csignal>
 #endif
 
 #define _(str) gettext(str)
 
 // 添加静态成员初始化
-std::filesystem::path LingmoPkgBuilder::s_buildDir = ".build_deb_lingmo";
-std::filesystem::path LingmoPkgBuilder::s_outputDir = "pkg_out";
-int LingmoPkgBuilder::s_threadCount = 1;  // 默认单线程
-bool LingmoPkgBuilder::s_signBuild = true;        // 默认进行签名
-std::string LingmoPkgBuilder::s_signKey = "";     // 默认使用默认密钥
+LingmoPkgBuilder::Options LingmoPkgBuilder::s_defaults;
+std::function<void(const std::filesystem::path&)> LingmoPkgBuilder::s_changesHandler;
+
+namespace {
+
+using build_utils::shellQuote;
+using build_utils::captureCommand;
+using build_utils::Stanza;
+using build_utils::readStanzas;
+using build_utils::fieldValue;
+
+std::string captureOutput(const std::string& cmd) {
+    std::string output;
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (!pipe) return output;
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), pipe)) {
+        output += buffer;
+    }
+    pclose(pipe);
+    while (!output.empty() && std::isspace(static_cast<unsigned char>(output.back()))) {
+        output.pop_back();
+    }
+    return output;
+}
+
+// 展开 ${var} 变量，未定义的变量替换为空；关系字段中因此产生的空项一并去掉
+std::string expandSubstvars(const std::string& field, const std::string& value,
+                            const std::map<std::string, std::string>& vars) {
+    std::string result;
+    size_t pos = 0;
+    while (pos < value.size()) {
+        auto start = value.find("${", pos);
+        auto end = start == std::string::npos ? std::string::npos : value.find('}', start);
+        if (end == std::string::npos) {
+            result += value.substr(pos);
+            break;
+        }
+        result += value.substr(pos, start - pos);
+        auto it = vars.find(value.substr(start + 2, end - start - 2));
+        if (it != vars.end()) result += it->second;
+        pos = end + 1;
+    }
+
+    static const char* relations[] = { "Pre-Depends", "Depends", "Recommends", "Suggests", "Enhances",
+                                       "Breaks", "Conflicts", "Provides", "Replaces", "Built-Using" };
+    if (std::find(std::begin(relations), std::end(relations), field) == std::end(relations)) {
+        return result;
+    }
+
+    std::string cleaned;
+    std::stringstream items(result);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        auto first = item.find_first_not_of(" \t\n");
+        if (first == std::string::npos) continue;
+        item = item.substr(first, item.find_last_not_of(" \t\n") - first + 1);
+        cleaned += (cleaned.empty() ? "" : ", ") + item;
+    }
+    return cleaned;
+}
+
+// ar 成员头固定 60 字节，所有字段左对齐并用空格填充
+void writeArHeader(std::ostream& out, const std::string& name, long mtime, std::uintmax_t size) {
+    char header[61];
+    std::snprintf(header, sizeof(header), "%-16s%-12ld%-6d%-6d%-8s%-10ju`\n",
+                  name.c_str(), mtime, 0, 0, "100644", size);
+    out.write(header, 60);
+}
+
+#ifdef HAVE_UNISTD_H
+// 以 root 为根的进程树中所有进程当前 RSS 之和 (KiB)。wait4 的 ru_maxrss 只是其中
+// 最大的单个进程的峰值，-j 构建同时运行多个编译器时远小于整棵进程树的占用
+long processTreeRssKb(pid_t root) {
+    static const long pageKb = sysconf(_SC_PAGESIZE) / 1024;
+    std::map<pid_t, std::vector<pid_t>> children;
+    std::map<pid_t, long> rss;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it("/proc", ec), end; !ec && it != end; it.increment(ec)) {
+        auto name = it->path().filename().string();
+        if (name.empty() || !std::isdigit(static_cast<unsigned char>(name[0]))) continue;
+        std::ifstream statFile(it->path() / "stat");
+        std::string stat;
+        if (!std::getline(statFile, stat)) continue;
+
+        // 进程名可能包含空格和括号，其后的字段依次为 state ppid ...，第 22 个是 rss 页数
+        auto nameEnd = stat.rfind(')');
+        if (nameEnd == std::string::npos) continue;
+        std::istringstream fields(stat.substr(nameEnd + 1));
+        std::string field;
+        long ppid = 0, pages = 0;
+        for (int i = 0; i < 22 && fields >> field; ++i) {
+            if (i == 1) ppid = std::atol(field.c_str());
+            if (i == 21) pages = std::atol(field.c_str());
+        }
+        pid_t pid = std::atoi(name.c_str());
+        children[ppid].push_back(pid);
+        rss[pid] = pages * pageKb;
+    }
+
+    long total = 0;
+    std::vector<pid_t> stack = { root };
+    while (!stack.empty()) {
+        pid_t pid = stack.back();
+        stack.pop_back();
+        total += rss[pid];
+        const auto& next = children[pid];
+        stack.insert(stack.end(), next.begin(), next.end());
+    }
+    return total;
+}
+#endif
+
+} // namespace
 
 LingmoPkgBuilder::LingmoPkgBuilder(const std::filesystem::path& sourceDir, PackageType type)
-    : m_packageType(type) {
+    : LingmoPkgBuilder(sourceDir, s_defaults, type) {}
+
+LingmoPkgBuilder::LingmoPkgBuilder(const std::filesystem::path& sourceDir, const Options& options,
+                                   PackageType type)
+    : m_options(options), m_packageType(type) {
     // 先从 changelog 获取正确的包名
     std::string correctName;
     {
@@ -39,37 +170,20 @@ LingmoPkgBuilder::LingmoPkgBuilder(const std::filesystem::path& sourceDir, Packa
         throw std::runtime_error(_("Unable to get package name from changelog"));
     }
 
-    m_tempDir = s_buildDir / correctName;
+    m_tempDir = m_options.buildDir / correctName;
+    m_binaryRoot = m_tempDir;
     std::filesystem::create_directories(m_tempDir);
 
-    if (sourceDir.parent_path() != s_buildDir) {
-        try {
-            for (const auto& entry : std::filesystem::directory_iterator(sourceDir)) {
-                const auto& path = entry.path();
-                auto destPath = m_tempDir / entry.path().filename();
-                if (entry.is_directory()) {
-                    std::filesystem::copy(path, destPath,
-                        std::filesystem::copy_options::recursive |
-                        std::filesystem::copy_options::overwrite_existing);
-                } else {
-                    std::filesystem::copy(path, destPath,
-                        std::filesystem::copy_options::overwrite_existing);
-                }
-            }
-        } catch (const std::exception& e) {
-            throw std::runtime_error(std::string(_("Failed to copy source files")) + ": " + e.what());
-        }
-    }
-
-    if (!parseChangelogFile(m_tempDir / "debian/changelog")) {
+    // 元数据直接从源目录读取，源码在构建的 Stage 阶段才复制到 m_tempDir
+    if (!parseChangelogFile(sourceDir / "debian/changelog")) {
         std::cerr << _("Warning: Unable to get version from changelog") << "\n";
     }
     
-    if (!parseControlFile(m_tempDir / "debian/control")) {
+    if (!parseControlFile(sourceDir / "debian/control")) {
         throw std::runtime_error(_("Failed to parse control file"));
     }
     
-    auto formatFile = m_tempDir / "debian/source/format";
+    auto formatFile = sourceDir / "debian/source/format";
     if (std::filesystem::exists(formatFile)) {
         std::ifstream format(formatFile);
         std::string formatStr;
@@ -93,23 +207,236 @@ void LingmoPkgBuilder::setDescription(const std::string& description) {
 }
 
 bool LingmoPkgBuilder::createControlFile() {
-    auto controlDir = m_tempDir / "DEBIAN";
+    auto controlDir = m_debDir / "control";
+    std::filesystem::remove_all(controlDir);
     std::filesystem::create_directories(controlDir);
-    
-    std::ofstream control(controlDir / "control");
-    if (!control.is_open()) return false;
-
-    control << "Package: " << m_packageName << "\n"
-            << "Version: " << m_version << "\n"
-            << "Architecture: " << m_architecture << "\n"
-            << "Maintainer: " << m_maintainer << "\n"
-            << "Description: " << m_description << "\n";
-    
+
+    if (std::filesystem::exists(m_binaryRoot / "DEBIAN/control")) {
+        // dh_gencontrol 已经生成了完整的 control 和维护脚本，直接使用
+        std::filesystem::copy(m_binaryRoot / "DEBIAN", controlDir,
+            std::filesystem::copy_options::recursive);
+    } else {
+        // Installed-Size 按 dpkg-gencontrol 的方式计算：文件按 KiB 向上取整，其他条目各计 1
+        std::uintmax_t installedSize = 0;
+        for (auto it = std::filesystem::recursive_directory_iterator(m_binaryRoot);
+             it != std::filesystem::recursive_directory_iterator(); ++it) {
+            if (it->path().filename() == "DEBIAN" && it.depth() == 0) {
+                it.disable_recursion_pending();
+                continue;
+            }
+            if (it->is_regular_file() && !it->is_symlink()) {
+                installedSize += (it->file_size() + 1023) / 1024;
+            } else {
+                installedSize += 1;
+            }
+        }
+
+        std::ofstream control(controlDir / "control");
+        if (!control.is_open()) return false;
+
+        control << "Package: " << m_packageName << "\n"
+                << "Version: " << m_version << "\n"
+                << "Architecture: " << m_architecture << "\n"
+                << "Maintainer: " << m_maintainer << "\n"
+                << "Installed-Size: " << installedSize << "\n";
+        for (const auto& [name, value] : m_controlFields) {
+            if (!value.empty()) control << name << ": " << value << "\n";
+        }
+        control << "Description: " << m_description << "\n";
+    }
+
+    if (!std::filesystem::exists(controlDir / "md5sums")) {
+        std::string cmd = "cd " + shellQuote(m_binaryRoot) + " && "
+                        + "find . -path ./DEBIAN -prune -o -type f -print0 | LC_ALL=C sort -z"
+                        + " | xargs -0r md5sum | sed 's|  \\./|  |' > " + shellQuote(controlDir / "md5sums");
+        if (!runStep(cmd)) {
+            std::cerr << _("Failed to generate md5sums") << "\n";
+            return false;
+        }
+        if (std::filesystem::file_size(controlDir / "md5sums") == 0) {
+            std::filesystem::remove(controlDir / "md5sums");
+        }
+    }
+
+    return createTarArchive(controlDir, "control.tar");
+}
+
+bool LingmoPkgBuilder::createDataArchive() {
+    return createTarArchive(m_binaryRoot, "data.tar", "./DEBIAN");
+}
+
+bool LingmoPkgBuilder::createDebianBinary() {
+    std::ofstream out(m_debDir / "debian-binary");
+    out << "2.0\n";
+    return out.good();
+}
+
+bool LingmoPkgBuilder::createTarArchive(const std::filesystem::path& root, const std::string& member,
+                                        const std::string& exclude) const {
+    // 固定排序、属主和时间戳，相同的目录树总是生成相同的归档
+    auto tarFile = m_debDir / member;
+    std::string cmd = "tar -C " + shellQuote(root) + " --sort=name --format=gnu"
+                    + " --owner=0 --group=0 --numeric-owner"
+                    + " --mtime=@" + std::to_string(m_sourceDateEpoch) + " --clamp-mtime"
+                    + (exclude.empty() ? "" : " --exclude=" + shellQuote(exclude))
+                    + " -cf " + shellQuote(tarFile) + " .";
+
+    if (m_options.compression == Compression::Zstd) {
+        cmd += " && zstd -q --rm -19 -T0 " + shellQuote(tarFile);
+    } else {
+        cmd += " && xz -T0 " + shellQuote(tarFile);
+    }
+
+    if (!runStep(cmd)) {
+        std::cerr << _("Failed to create archive") << " " << member << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool LingmoPkgBuilder::writeDebFile(const std::filesystem::path& debFile) const {
+    std::string ext = m_options.compression == Compression::Zstd ? ".zst" : ".xz";
+    std::vector<std::string> members = { "debian-binary", "control.tar" + ext, "data.tar" + ext };
+
+    auto tmp = debFile;
+    tmp += ".new";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out.is_open()) {
+            std::cerr << _("Unable to write package") << ": " << debFile << "\n";
+            return false;
+        }
+
+        out << "!<arch>\n";
+        for (const auto& member : members) {
+            auto path = m_debDir / member;
+            auto size = std::filesystem::file_size(path);
+            writeArHeader(out, member, m_sourceDateEpoch, size);
+
+            std::ifstream in(path, std::ios::binary);
+            out << in.rdbuf();
+            // ar 成员按 2 字节对齐
+            if (size % 2) out << '\n';
+        }
+        if (!out.good()) return false;
+    }
+    std::filesystem::rename(tmp, debFile);
     return true;
 }
 
+bool LingmoPkgBuilder::buildBinaryOnly(const std::filesystem::path& sourceDir) {
+    auto stanzas = readStanzas(sourceDir / "debian/control");
+    if (stanzas.size() < 2) {
+        std::cerr << _("Error: No binary packages in control file") << "\n";
+        return false;
+    }
+
+    // 与 dpkg 一样优先使用 SOURCE_DATE_EPOCH，否则取 changelog 的日期
+    if (const char* epoch = std::getenv("SOURCE_DATE_EPOCH")) {
+        m_sourceDateEpoch = std::atol(epoch);
+    } else {
+        m_sourceDateEpoch = std::atol(captureOutput("dpkg-parsechangelog -l "
+            + shellQuote(sourceDir / "debian/changelog") + " -STimestamp 2>/dev/null").c_str());
+    }
+
+    const auto& source = stanzas[0];
+    std::string sourceName = m_packageName;
+    std::string hostArch = captureOutput("dpkg --print-architecture");
+    std::string fileVersion = m_version.substr(m_version.find(':') + 1);
+    size_t binaries = stanzas.size() - 1;
+
+    bool success = true;
+    int built = 0;
+    for (size_t i = 1; i < stanzas.size(); ++i) {
+        const auto& stanza = stanzas[i];
+        std::string name = fieldValue(stanza, "Package");
+        std::string arch = fieldValue(stanza, "Architecture");
+        if (name.empty()) continue;
+
+        if (arch != "all") {
+            std::istringstream archs(arch);
+            std::string candidate;
+            bool matches = false;
+            while (archs >> candidate) {
+                if (candidate == "any" || candidate == hostArch || candidate == "linux-any") matches = true;
+            }
+            if (!matches) continue;
+            arch = hostArch;
+        }
+
+        // dh_install 按包名安装到 debian/<包名>，单包时也可能只有 debian/tmp
+        auto root = sourceDir / "debian" / name;
+        if (!std::filesystem::is_directory(root) && binaries == 1) {
+            root = sourceDir / "debian/tmp";
+        }
+        if (!std::filesystem::is_directory(root)) {
+            std::cerr << _("Warning: No install tree for") << " " << name << "\n";
+            continue;
+        }
+
+        std::map<std::string, std::string> vars = {
+            { "binary:Version", m_version },
+            { "source:Version", m_version },
+            { "Arch", arch },
+        };
+        std::ifstream substvars(sourceDir / "debian" / (name + ".substvars"));
+        std::string line;
+        while (std::getline(substvars, line)) {
+            auto eq = line.find('=');
+            if (eq == std::string::npos) continue;
+            auto key = line.substr(0, eq);
+            if (!key.empty() && key.back() == '?') key.pop_back();
+            vars[key] = line.substr(eq + 1);
+        }
+
+        m_packageName = name;
+        m_architecture = arch;
+        m_maintainer = fieldValue(source, "Maintainer");
+        m_description = fieldValue(stanza, "Description");
+        m_controlFields.clear();
+        if (name != sourceName) {
+            m_controlFields.emplace_back("Source", sourceName);
+        }
+        for (const auto& [key, value] : stanza) {
+            if (key == "Package" || key == "Architecture" || key == "Description" ||
+                key == "Package-Type" || key == "Build-Profiles") continue;
+            m_controlFields.emplace_back(key, expandSubstvars(key, value, vars));
+        }
+        for (const char* key : { "Section", "Priority", "Homepage" }) {
+            if (fieldValue(stanza, key).empty() && !fieldValue(source, key).empty()) {
+                m_controlFields.emplace_back(key, fieldValue(source, key));
+            }
+        }
+
+        m_binaryRoot = root;
+        m_debDir = m_tempDir / (".deb-" + name);
+        std::filesystem::remove_all(m_debDir);
+        std::filesystem::create_directories(m_debDir);
+        std::filesystem::create_directories(m_options.outputDir);
+
+        auto debFile = m_options.outputDir / (name + "_" + fileVersion + "_" + arch + ".deb");
+        if (createDebianBinary() && createControlFile() && createDataArchive() && writeDebFile(debFile)) {
+            std::cout << _("Created package") << ": " << debFile << "\n";
+            addArtifact(debFile);
+            ++built;
+        } else {
+            std::cerr << _("Failed to assemble package") << " " << name << "\n";
+            success = false;
+        }
+        std::filesystem::remove_all(m_debDir);
+    }
+
+    m_packageName = sourceName;
+    m_binaryRoot = m_tempDir;
+    if (built == 0) {
+        std::cerr << _("Error: No binary package was assembled") << "\n";
+        return false;
+    }
+    return success;
+}
+
 void LingmoPkgBuilder::addFile(const std::string& sourcePath, const std::string& destPath) {
-    auto targetPath = m_tempDir / destPath;
+    auto targetPath = m_binaryRoot / destPath;
     std::filesystem::create_directories(targetPath.parent_path());
     std::filesystem::copy_file(sourcePath, targetPath);
 }
@@ -145,11 +472,11 @@ bool LingmoPkgBuilder::createOrigTarball() const {
         }
 
         // 创建 orig tarball，使用正确的目录名
-        std::string tarCmd = "cd " + m_tempDir.string() + " && "
-                          + "tar -Jcf " + m_packageName + "_" + upstreamVersion + ".orig.tar.xz "
-                          + m_packageName;
+        std::string tarCmd = "cd " + shellQuote(m_tempDir) + " && "
+                          + "tar -Jcf " + shellQuote(m_packageName + "_" + upstreamVersion + ".orig.tar.xz") + " "
+                          + shellQuote(m_packageName);
         
-        bool result = std::system(tarCmd.c_str()) == 0;
+        bool result = runStep(tarCmd);
         
         // 清理临时源码目录
         std::filesystem::remove_all(tempSourceDir);
@@ -163,54 +490,162 @@ bool LingmoPkgBuilder::createOrigTarball() const {
 
 bool LingmoPkgBuilder::build(const std::filesystem::path& sourceDir) {
     try {
-        std::string cpCmd = "cp -r " + sourceDir.string() + "/* " + m_tempDir.string();
-        if (!runCommand(cpCmd)) {
-            std::cerr << _("Failed to copy source files") << "\n";
-            return false;
+        if (m_options.binaryOnly) {
+            auto start = std::chrono::steady_clock::now();
+            bool success = runPhase(BuildPhase::Assemble, [&]() { return buildBinaryOnly(sourceDir); });
+            m_usage = BuildUsage{};
+            m_usage.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return success;
         }
 
+        bool staged = runPhase(BuildPhase::Stage, [&]() {
+            std::error_code ec;
+            if (std::filesystem::equivalent(sourceDir, m_tempDir, ec)) {
+                return true;  // 源码已经位于构建目录中
+            }
+            // 每次重新暂存，上次构建残留的文件不会进入本次构建和 orig 源码包
+            std::filesystem::remove_all(m_tempDir);
+            return SourceStager::stage(sourceDir, m_tempDir, &m_staged);
+        });
+        if (!staged) return false;
+
+        std::filesystem::path origTarball;
         if (!isNativePackage()) {
             std::string upstreamVersion = m_version;
             size_t dashPos = m_version.find('-');
             if (dashPos != std::string::npos) {
                 upstreamVersion = m_version.substr(0, dashPos);
             }
+            origTarball = m_tempDir.parent_path() / (m_packageName + "_" + upstreamVersion + ".orig.tar.xz");
 
-            std::string tarCmd = "cd " + m_tempDir.parent_path().string() + " && "
-                              + "tar --exclude=debian -Jcf " + m_packageName + "_" + upstreamVersion + ".orig.tar.xz "
-                              + "-C " + m_packageName + " .";
+            bool packed = runPhase(BuildPhase::OrigTarball, [&]() {
+                // 固定文件顺序、属主和时间戳，相同的源码总是生成相同的 orig，
+                // 源码包缓存和仓库中的校验和因此保持稳定
+                std::string timestamp;
+                if (!captureCommand("dpkg-parsechangelog -l " + shellQuote(m_tempDir / "debian/changelog")
+                                    + " -STimestamp 2>/dev/null", timestamp)) {
+                    timestamp.clear();
+                }
+                timestamp = build_utils::firstWord(timestamp);
 
-            if (!runCommand(tarCmd)) {
-                std::cerr << _("Failed to create orig tarball") << "\n";
-                return false;
+                std::string tarCmd = "cd " + shellQuote(m_tempDir.parent_path()) + " && "
+                                  + "tar --exclude=debian --sort=name --owner=0 --group=0 --numeric-owner "
+                                  + "--mtime=@" + (timestamp.empty() ? "0" : timestamp) + " "
+                                  + "-Jcf " + shellQuote(origTarball.filename()) + " "
+                                  + "-C " + shellQuote(m_packageName) + " .";
+
+                if (!runStep(tarCmd)) {
+                    std::cerr << _("Failed to create orig tarball") << "\n";
+                    return false;
+                }
+                return true;
+            });
+            if (!packed) return false;
+        }
+
+        bool isolated = !m_options.isolatedRoot.empty();
+        auto workDir = std::filesystem::absolute(m_tempDir);
+
+        // debian/ 和 orig 都未变化时直接使用上次 dpkg-source 生成的文件，只构建二进制包
+        std::string version = m_version.substr(m_version.find(':') + 1);
+        auto dscFile = m_tempDir.parent_path() / (m_packageName + "_" + version + ".dsc");
+        SourceCache sourceCache(m_options.buildDir);
+        std::string sourceKey;
+        bool sourceCached = false;
+        if (m_options.sourceCache) {
+            std::string options = std::string("sign=") + (m_options.sign ? m_options.signKey : "no");
+            sourceKey = SourceCache::computeKey(m_tempDir, origTarball, options);
+            sourceCached = !sourceKey.empty() && sourceCache.fetch(m_packageName, sourceKey, dscFile);
+            if (sourceCached) {
+                std::cout << _("Reusing cached source package") << ": " << dscFile.filename().string() << "\n";
             }
         }
 
-        std::string buildCmd = "cd " + m_tempDir.string() + " && dpkg-buildpackage";
+        std::string buildCmd = "cd " + shellQuote(workDir) + " && dpkg-buildpackage";
         
-        if (s_threadCount > 1) {
-            buildCmd += " -j" + std::to_string(s_threadCount);
+        if (m_options.threads > 1) {
+            buildCmd += " -j" + std::to_string(m_options.threads);
         }
         
-        if (!s_signBuild) {
+        // 隔离环境中没有签名密钥，使用缓存的源码包时 changes 需要重新生成，
+        // 这两种情况都在构建完成后用 debsign 签名
+        bool signAfterBuild = isolated || sourceCached;
+        if (!m_options.sign || signAfterBuild) {
             buildCmd += " -us -uc --no-sign";
-        } else if (!s_signKey.empty()) {
-            buildCmd += " -k" + s_signKey;
+        } else if (!m_options.signKey.empty()) {
+            buildCmd += " -k" + shellQuote(m_options.signKey);
         }
         
-        if (!isNativePackage()) {
+        if (sourceCached) {
+            buildCmd += " -b";
+        } else if (!isNativePackage()) {
             buildCmd += " -sa";
         }
 
-        if (!runCommand(buildCmd)) {
-            std::cerr << _("Build command failed") << "\n";
+        bool built = runPhase(BuildPhase::Build, [&]() {
+            // 每个构建独占一个 cgroup，内存超限只影响本包，并能统计整个进程树的资源占用
+            BuildCgroup cgroup(m_packageName);
+            auto cgroupProcs = cgroup.valid() ? cgroup.procsFile() : std::filesystem::path();
+
+            bool success;
+            if (isolated) {
+                // 构建依赖安装到一次性的上层中，构建结束后整个环境直接丢弃
+                IsolatedBuildEnv env(m_options.isolatedRoot, m_options.buildDir, m_options.outputDir);
+                std::string envCmd = "cd " + shellQuote(workDir)
+                                   + " && apt-get -o APT::Sandbox::User=root build-dep -y ./ && " + buildCmd;
+                success = runMeasured(env.wrap(m_packageName, envCmd), m_usage, cgroupProcs);
+                env.discard(m_packageName);
+            } else {
+                success = runMeasured(buildCmd, m_usage, cgroupProcs);
+            }
+            cgroup.collect(m_usage);
+            if (m_usage.oomKilled) {
+                std::cerr << _("Warning: Build was killed for exceeding its memory limit") << ": " << m_packageName << "\n";
+            }
+            if (success && sourceCached) {
+                success = generateChanges(workDir);
+            }
+            return success;
+        });
+
+        if (!built) {
+            std::cerr << (cancelled() ? _("Build cancelled") : _("Build command failed")) << "\n";
             return false;
         }
 
-        if (!copyArtifacts(m_packageName)) {
+        if (signAfterBuild && m_options.sign) {
+            bool signedOk = runPhase(BuildPhase::Sign, [&]() {
+                auto changesFile = findChangesFile(m_tempDir.parent_path());
+                // 缓存的 dsc 已经签过名，保留原签名
+                std::string signCmd = "debsign --no-re-sign"
+                                    + (m_options.signKey.empty() ? "" : " -k" + shellQuote(m_options.signKey))
+                                    + " " + shellQuote(changesFile);
+                if (changesFile.empty() || !runStep(signCmd)) {
+                    std::cerr << _("Failed to sign changes file") << "\n";
+                    return false;
+                }
+                return true;
+            });
+            if (!signedOk) return false;
+        }
+
+        if (!sourceKey.empty() && !sourceCached && std::filesystem::exists(dscFile)) {
+            sourceCache.store(m_packageName, sourceKey, dscFile);
+        }
+
+        if (!runPhase(BuildPhase::Collect, [&]() { return copyArtifacts(m_packageName); })) {
             std::cerr << _("Failed to copy artifacts") << "\n";
             return false;
         }
+
+        if (s_changesHandler) {
+            auto changesFile = findChangesFile(m_options.outputDir);
+            if (changesFile.empty()) {
+                std::cerr << _("Warning: No changes file found for") << " " << m_packageName << "\n";
+            } else {
+                s_changesHandler(changesFile);
+            }
+        }
         
         return true;
     } catch (const std::exception& e) {
@@ -341,27 +776,86 @@ bool LingmoPkgBuilder::copyDebianFiles(const std::filesystem::path& debianDir) {
     }
 }
 
-bool LingmoPkgBuilder::buildFromDirectory(const std::filesystem::path& sourceDir, 
-                                  const std::string& outputPath) {
+BuildResult LingmoPkgBuilder::execute(const Request& request, const std::shared_ptr<BuildControl>& control) {
+    BuildResult result;
     try {
-        // 直接使用源目录构造 LingmoPkgBuilder
-        LingmoPkgBuilder builder(sourceDir);
-        return builder.build(sourceDir);
+        LingmoPkgBuilder builder(request.sourceDir, request.options);
+        builder.m_onEvent = request.onEvent;
+        builder.m_control = control;
+        result.success = builder.build(request.sourceDir);
+        result.usage = builder.m_usage;
+        result.artifacts = builder.m_artifacts;
+        result.stagedFiles = builder.m_staged.files;
+        result.stagedBytes = builder.m_staged.bytes;
+        if (result.success) {
+            result.changesFile = builder.findChangesFile(request.options.outputDir);
+        }
     } catch (const std::exception& e) {
         std::cerr << _("Build failed") << ": " << e.what() << "\n";
-        return false;
     }
+
+    if (control && control->cancelled) {
+        result.cancelled = true;
+        result.success = false;
+    }
+    return result;
+}
+
+BuildHandle LingmoPkgBuilder::start(Request request) {
+    auto control = std::make_shared<BuildControl>();
+    auto result = std::async(std::launch::async, [request = std::move(request), control]() {
+        return execute(request, control);
+    });
+    return BuildHandle(control, result.share());
 }
 
-bool LingmoPkgBuilder::copyArtifacts(const std::string& packageName) const {
+bool LingmoPkgBuilder::buildFromDirectory(const std::filesystem::path& sourceDir, 
+                                  const std::string& outputPath,
+                                  BuildUsage* usage,
+                                  std::filesystem::path* changesFile) {
+    Request request;
+    request.sourceDir = sourceDir;
+    if (!outputPath.empty()) {
+        request.options.outputDir = outputPath;
+    }
+
+    auto result = execute(request, nullptr);
+    if (usage) {
+        *usage = result.usage;
+    }
+    if (result.success && changesFile) {
+        *changesFile = result.changesFile;
+    }
+    return result.success;
+}
+
+bool LingmoPkgBuilder::copyArtifacts(const std::string& packageName) {
     try {
-        std::filesystem::create_directories(s_outputDir);
-        
+        std::filesystem::create_directories(m_options.outputDir);
+        auto buildDir = m_tempDir.parent_path();
+
+        // 多个包并行构建时共用同一个构建目录，只复制本包 changes 中列出的文件
+        auto changesFile = findChangesFile(buildDir);
+        if (!changesFile.empty()) {
+            std::vector<std::filesystem::path> files = { changesFile };
+            for (const auto& file : build_utils::changesFiles(changesFile)) {
+                files.push_back(file);
+            }
+
+            for (const auto& file : files) {
+                std::filesystem::copy(file, m_options.outputDir / file.filename(),
+                    std::filesystem::copy_options::update_existing);
+                addArtifact(m_options.outputDir / file.filename());
+            }
+            return true;
+        }
+
         // 复制所有非目录文件
-        for (const auto& entry : std::filesystem::directory_iterator(m_tempDir.parent_path())) {
-            if (!entry.is_directory()) {  // 只复制文件，不复制目录
-                std::filesystem::copy(entry.path(), s_outputDir / entry.path().filename(),
+        for (const auto& entry : std::filesystem::directory_iterator(buildDir)) {
+            if (!entry.is_directory() && entry.path().filename() != BuildHistory::kFileName) {
+                std::filesystem::copy(entry.path(), m_options.outputDir / entry.path().filename(),
                     std::filesystem::copy_options::update_existing);
+                addArtifact(m_options.outputDir / entry.path().filename());
             }
         }
         return true;
@@ -371,11 +865,245 @@ bool LingmoPkgBuilder::copyArtifacts(const std::string& packageName) const {
     }
 }
 
+std::filesystem::path LingmoPkgBuilder::findChangesFile(const std::filesystem::path& dir) const {
+    // changes 文件名为 <源码包>_<不含 epoch 的版本>_<架构>.changes
+    std::string version = m_version;
+    size_t colonPos = version.find(':');
+    if (colonPos != std::string::npos) {
+        version = version.substr(colonPos + 1);
+    }
+    std::string prefix = m_packageName + "_" + version + "_";
+
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        auto name = entry.path().filename().string();
+        if (entry.path().extension() == ".changes" && name.compare(0, prefix.size(), prefix) == 0) {
+            return entry.path();
+        }
+    }
+    return {};
+}
+
+bool LingmoPkgBuilder::generateChanges(const std::filesystem::path& workDir) const {
+    auto changesFile = findChangesFile(m_tempDir.parent_path());
+    if (changesFile.empty()) {
+        std::cerr << _("Error: No changes file found for") << " " << m_packageName << "\n";
+        return false;
+    }
+
+    // 覆盖 dpkg-buildpackage -b 生成的只含二进制包的 changes
+    std::string cmd = "cd " + shellQuote(workDir) + " && dpkg-genchanges --build=full"
+                    + (isNativePackage() ? "" : " -sa")
+                    + " -O" + shellQuote(std::filesystem::absolute(changesFile));
+    if (!runStep(cmd)) {
+        std::cerr << _("Failed to generate changes file") << "\n";
+        return false;
+    }
+    return true;
+}
+
 bool LingmoPkgBuilder::runCommand(const std::string& cmd) {
     int result = std::system(cmd.c_str());
     return result == 0;
 }
 
+bool LingmoPkgBuilder::runStep(const std::string& cmd) const {
+    BuildUsage usage;
+    return runMeasured(cmd, usage);
+}
+
+void LingmoPkgBuilder::emit(BuildEvent event) const {
+    if (!m_onEvent) return;
+    // --binary-only 时 m_packageName 会临时改为二进制包名，构建目录名始终是源码包名
+    event.package = m_tempDir.filename().string();
+    m_onEvent(event);
+}
+
+bool LingmoPkgBuilder::runPhase(BuildPhase phase, const std::function<bool()>& step) {
+    if (cancelled()) return false;
+
+    BuildEvent event;
+    event.type = BuildEvent::Type::PhaseStarted;
+    event.phase = phase;
+    emit(event);
+
+    bool success = step() && !cancelled();
+
+    event.type = BuildEvent::Type::PhaseFinished;
+    event.success = success;
+    emit(event);
+    return success;
+}
+
+void LingmoPkgBuilder::addArtifact(const std::filesystem::path& file) {
+    m_artifacts.push_back(file);
+
+    BuildEvent event;
+    event.type = BuildEvent::Type::Artifact;
+    event.phase = m_options.binaryOnly ? BuildPhase::Assemble : BuildPhase::Collect;
+    event.artifact = file;
+    emit(event);
+}
+
+bool LingmoPkgBuilder::runMeasured(const std::string& cmd, BuildUsage& usage,
+                                   const std::filesystem::path& cgroupProcs) const {
+    auto start = std::chrono::steady_clock::now();
+    usage = BuildUsage{};
+
+#ifdef HAVE_UNISTD_H
+    // 有事件回调时通过管道读取命令输出，按行作为日志事件转发
+    int pipeFds[2] = { -1, -1 };
+    if (m_onEvent && pipe2(pipeFds, O_CLOEXEC) != 0) {
+        return false;
+    }
+    bool ownGroup = static_cast<bool>(m_control);
+
+    // 用 wait4 取得子进程树的 CPU 时间和峰值内存，std::system 无法提供这些信息
+    pid_t pid = fork();
+    if (pid < 0) {
+        if (pipeFds[0] >= 0) {
+            close(pipeFds[0]);
+            close(pipeFds[1]);
+        }
+        return false;
+    }
+    if (pid == 0) {
+        // fork 之后只能使用异步信号安全的系统调用
+        if (ownGroup) {
+            setpgid(0, 0);
+        }
+        // 调用方可能为等待信号的线程屏蔽了 SIGINT/SIGTERM，构建命令需要能被取消
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        if (pipeFds[1] >= 0) {
+            int devNull = open("/dev/null", O_RDONLY);
+            if (devNull >= 0) dup2(devNull, STDIN_FILENO);
+            dup2(pipeFds[1], STDOUT_FILENO);
+            dup2(pipeFds[1], STDERR_FILENO);
+        }
+        if (!cgroupProcs.empty()) {
+            int fd = open(cgroupProcs.c_str(), O_WRONLY);
+            if (fd >= 0) {
+                ssize_t written = write(fd, "0", 1);
+                (void)written;
+                close(fd);
+            }
+        }
+        execl("/bin/sh", "sh", "-c", cmd.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+
+    if (ownGroup) {
+        // 父子进程都设置进程组，避免取消请求早于子进程的 setpgid
+        setpgid(pid, pid);
+        m_control->processGroup = pid;
+        if (m_control->cancelled) {
+            kill(-pid, SIGTERM);
+        }
+    }
+
+    // 没有 cgroup 统计整棵进程树的峰值内存时，运行期间定期采样进程树的 RSS
+    bool sampleTree = cgroupProcs.empty();
+    long sampledPeakKb = 0;
+    std::chrono::steady_clock::time_point lastSample;
+    auto sample = [&]() {
+        auto now = std::chrono::steady_clock::now();
+        if (!sampleTree || now - lastSample < std::chrono::milliseconds(250)) return;
+        lastSample = now;
+        sampledPeakKb = std::max(sampledPeakKb, processTreeRssKb(pid));
+    };
+
+    int status = 0;
+    struct rusage ru{};
+    pid_t waited = 0;
+    if (pipeFds[0] >= 0) {
+        close(pipeFds[1]);
+        BuildEvent event;
+        event.type = BuildEvent::Type::Log;
+        std::string pending;
+        char buffer[4096];
+
+        // 命令留下的后台进程会继承管道的写端，不能一直读到 EOF 才回收子进程。
+        // 边读边检查子进程是否退出，退出后只再读取一小段时间内已经写入的输出
+        std::chrono::steady_clock::time_point drainDeadline;
+        while (true) {
+            if (waited == 0) {
+                waited = wait4(pid, &status, WNOHANG, &ru);
+                if (waited < 0 && errno == EINTR) waited = 0;
+                if (waited != 0) {
+                    drainDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+                } else {
+                    sample();
+                }
+            }
+            int timeout = 100;
+            if (waited != 0) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    drainDeadline - std::chrono::steady_clock::now()).count();
+                if (remaining <= 0) break;
+                timeout = static_cast<int>(std::min<decltype(remaining)>(remaining, timeout));
+            }
+
+            struct pollfd readable = { pipeFds[0], POLLIN, 0 };
+            int ready = poll(&readable, 1, timeout);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (ready == 0) continue;
+
+            ssize_t len = read(pipeFds[0], buffer, sizeof(buffer));
+            if (len == 0) break;
+            if (len < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            pending.append(buffer, len);
+            size_t newline;
+            while ((newline = pending.find('\n')) != std::string::npos) {
+                event.line = pending.substr(0, newline);
+                emit(event);
+                pending.erase(0, newline + 1);
+            }
+        }
+        if (!pending.empty()) {
+            event.line = pending;
+            emit(event);
+        }
+        close(pipeFds[0]);
+    }
+
+    // 采样时轮询等待，间隔逐步加长，很快结束的命令不会因此多等
+    auto interval = std::chrono::milliseconds(10);
+    while (waited == 0) {
+        waited = wait4(pid, &status, sampleTree ? WNOHANG : 0, &ru);
+        if (waited < 0 && errno == EINTR) {
+            waited = 0;
+        } else if (waited == 0) {
+            sample();
+            std::this_thread::sleep_for(interval);
+            interval = std::min(interval * 2, std::chrono::milliseconds(250));
+        }
+    }
+    if (ownGroup) {
+        m_control->processGroup = 0;
+    }
+    if (waited < 0) {
+        return false;
+    }
+
+    usage.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    usage.cpuSeconds = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6
+                     + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+    usage.peakRssKb = std::max<long>(ru.ru_maxrss, sampledPeakKb);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+    bool result = runCommand(cmd);
+    usage.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+#endif
+}
+
 bool LingmoPkgBuilder::checkBuildDependencies(const std::filesystem::path& sourceDir) {
 #ifdef HAVE_UNISTD_H
     if (geteuid() != 0) {
@@ -1,6 +1,28 @@
 #include "lingmo_pkgbuild.h"
+#include "publish_queue.h"
+#include "build_scheduler.h"
+#include "incremental_state.h"
+#include "artifact_cache.h"
+#include "build_cgroup.h"
+#include "preflight.h"
+#include "metrics.h"
+#include "repo_manager.h"
 #include <iostream>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include <map>
+#include <list>
+#include <atomic>
+#include <thread>
+#include <iomanip>
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
+#include <csignal>
+#include <pthread.h>
 #include <libintl.h>
 #include <locale.h>
 
@@ -15,13 +37,113 @@ void printUsage(const char* programName) {
               << "  -o, --output   " << _("Specify output directory") << " (" << _("default") << ": pkg_out)\n"
               << "  -b, --build-dir " << _("Specify build directory") << " (" << _("default") << ": .build_deb_lingmo)\n"
               << "  -j, --jobs     " << _("Specify number of parallel builds") << " (" << _("default") << ": 1)\n"
+              << "  -p, --parallel " << _("Number of packages to build at the same time") << " (" << _("default") << ": 1)\n"
+              << "  --mem-limit <MB> " << _("Memory budget for concurrent builds") << " (" << _("default") << ": " << _("physical memory") << ")\n"
+              << "  --plan         " << _("Print the predicted build schedule and exit") << "\n"
+              << "  --binary-only  " << _("Package prebuilt debian/<package> trees without running debian/rules") << "\n"
+              << "  --compression <xz|zstd> " << _("Compression of the data and control archives") << " (" << _("default") << ": xz)\n"
+              << "  --cache <" << _("directory") << "|URL> " << _("Share build artifacts through a content-addressed cache") << "\n"
+              << "  --isolated <" << _("base root") << "> " << _("Build each package in a disposable overlay over the base root") << "\n"
+              << "  --memory-max <MB> " << _("Memory limit of each build's cgroup") << "\n"
+              << "  --cpu-weight <1-10000> " << _("CPU weight of each build's cgroup") << "\n"
+              << "  --incremental  " << _("Skip packages whose sources and in-tree dependencies are unchanged") << "\n"
+              << "  --no-source-cache " << _("Always regenerate the source package instead of reusing an unchanged one") << "\n"
+              << "  --metrics-file <" << _("file") << "> " << _("Write Prometheus metrics for node_exporter's textfile collector") << "\n"
               << "  --no-sign      " << _("Do not sign the package") << "\n"
               << "  -k, --key      " << _("Specify signing key") << "\n"
               << "  --no-deps      " << _("Skip build dependency check") << "\n"
               << "  -c, --clean    " << _("Clean build directory before and after build") << "\n"
+              << "  --publish <" << _("repository") << "> <" << _("codename") << ">\n"
+              << "                 " << _("Import each package into the repository as soon as it is built") << "\n"
               << _("Note: Build dependency check requires root privileges") << "\n";
 }
 
+namespace {
+
+// 正在进行的构建，收到中断信号时全部取消
+std::mutex g_runningMutex;
+std::list<BuildHandle> g_running;
+std::atomic<bool> g_interrupted{false};
+std::mutex g_outputMutex;
+
+// 构建命令运行在各自的进程组中，收不到终端发出的 Ctrl-C，
+// 由本线程同步等待 SIGINT/SIGTERM 并取消所有正在进行的构建。
+// 信号在所有线程中保持屏蔽，再次收到信号时直接退出，用户仍可强制结束
+void watchInterrupts(sigset_t signals) {
+    int sig;
+    while (sigwait(&signals, &sig) == 0) {
+        bool again = g_interrupted.exchange(true);
+        std::lock_guard<std::mutex> lock(g_runningMutex);
+        std::cerr << "\n" << (again ? _("Interrupted again, exiting immediately")
+                                     : _("Interrupted, cancelling running builds")) << "\n";
+        for (const auto& handle : g_running) {
+            handle.cancel();
+        }
+        if (again) {
+            std::_Exit(128 + sig);
+        }
+    }
+}
+
+void describeMetrics() {
+    using lingmo::Metrics;
+    Metrics::describe("lingmo_pkgbuild_packages", "gauge", "Packages of the current run by state");
+    Metrics::describe("lingmo_pkgbuild_packages_total", "counter", "Packages handled by the current run by outcome");
+    Metrics::describe("lingmo_pkgbuild_cache_lookups_total", "counter", "Artifact cache lookups by result");
+    Metrics::describe("lingmo_pkgbuild_build_duration_seconds", "gauge", "Wall time of the last build of each package");
+    Metrics::describe("lingmo_pkgbuild_build_cpu_seconds", "gauge", "CPU time of the last build of each package");
+    Metrics::describe("lingmo_pkgbuild_build_peak_memory_bytes", "gauge", "Peak resident memory of the last build of each package");
+    Metrics::describe("lingmo_pkgbuild_build_success", "gauge", "Whether the last build of each package succeeded");
+    Metrics::describe("lingmo_pkgbuild_staged_files", "gauge", "Files staged into the build directory for each package");
+    Metrics::describe("lingmo_pkgbuild_staged_bytes", "gauge", "Bytes staged into the build directory for each package");
+    Metrics::describe("lingmo_pkgbuild_run_duration_seconds", "gauge", "Duration of the last lingmo-pkgbuild run");
+    Metrics::describe("lingmo_pkgbuild_run_success", "gauge", "Whether the last lingmo-pkgbuild run succeeded");
+    Metrics::describe("lingmo_pkgbuild_last_run_timestamp_seconds", "gauge", "Unix time of the last lingmo-pkgbuild run");
+    // 边构建边发布时仓库的导入和发布指标也写入同一文件
+    lingmo::RepoManager::describeMetrics();
+}
+
+} // namespace
+
+// 打印每个实际构建的包的资源占用
+void printSummary(const std::vector<std::tuple<std::string, BuildUsage, bool>>& summary) {
+    if (summary.empty()) return;
+
+    bool cgroupStats = false;
+    for (const auto& entry : summary) {
+        if (std::get<1>(entry).hasCgroupStats) cgroupStats = true;
+    }
+
+    std::cout << "\n" << _("Build summary") << ":\n"
+              << std::left << std::setw(28) << _("Package") << std::right
+              << std::setw(10) << _("Wall(s)") << std::setw(10) << _("CPU(s)") << std::setw(12) << _("Peak(MB)");
+    if (cgroupStats) {
+        std::cout << std::setw(12) << _("Read(MB)") << std::setw(12) << _("Write(MB)")
+                  << "  " << _("Stall cpu/mem/io(s)");
+    }
+    std::cout << "\n";
+
+    std::cout << std::fixed << std::setprecision(1);
+    for (const auto& [name, usage, success] : summary) {
+        std::cout << std::left << std::setw(28) << name << std::right
+                  << std::setw(10) << usage.wallSeconds << std::setw(10) << usage.cpuSeconds
+                  << std::setw(12) << usage.peakRssKb / 1024.0;
+        if (cgroupStats) {
+            std::cout << std::setw(12) << usage.ioReadBytes / 1048576.0
+                      << std::setw(12) << usage.ioWriteBytes / 1048576.0
+                      << "  " << usage.cpuStallSeconds << "/" << usage.memoryStallSeconds
+                      << "/" << usage.ioStallSeconds;
+        }
+        if (usage.oomKilled) {
+            std::cout << "  " << _("OOM killed");
+        } else if (!success) {
+            std::cout << "  " << _("failed");
+        }
+        std::cout << "\n";
+    }
+    std::cout << std::defaultfloat;
+}
+
 int main(int argc, char* argv[]) {
     setlocale(LC_ALL, "");
     bindtextdomain("lingmo-pkgbuild", "/usr/share/locale");
@@ -41,6 +163,20 @@ int main(int argc, char* argv[]) {
         std::string signKey;
         bool checkDeps = true;  // 默认检查依赖
         bool clean = false;     // 默认不清理
+        std::filesystem::path publishRepo;
+        std::string publishCodename;
+        int parallel = 1;
+        long memLimitMb = 0;    // 0 表示使用物理内存总量
+        bool planOnly = false;
+        bool incremental = false;
+        bool sourceCache = true;
+        bool binaryOnly = false;
+        std::string cacheLocation;
+        std::filesystem::path isolatedRoot;
+        long memoryMaxMb = 0;
+        int cpuWeight = 0;
+        auto compression = LingmoPkgBuilder::Compression::Xz;
+        auto runStart = std::chrono::steady_clock::now();
 
         // 解析命令行参数
         for (int i = 1; i < argc; ++i) {
@@ -103,6 +239,109 @@ int main(int argc, char* argv[]) {
                 checkDeps = false;
             } else if (arg == "-c" || arg == "--clean") {
                 clean = true;
+            } else if (arg == "--publish") {
+                if (i + 2 >= argc) {
+                    std::cerr << _("Error: --publish requires repository directory and codename") << "\n";
+                    return 1;
+                }
+                publishRepo = argv[++i];
+                publishCodename = argv[++i];
+            } else if (arg == "-p" || arg == "--parallel") {
+                if (++i >= argc) {
+                    std::cerr << _("Error: Missing parallel package count argument") << "\n";
+                    return 1;
+                }
+                try {
+                    parallel = std::stoi(argv[i]);
+                } catch (const std::exception&) {
+                    parallel = 0;
+                }
+                if (parallel < 1) {
+                    std::cerr << _("Error: Number of parallel packages must be greater than 0") << "\n";
+                    return 1;
+                }
+            } else if (arg == "--mem-limit") {
+                if (++i >= argc) {
+                    std::cerr << _("Error: Missing memory limit argument") << "\n";
+                    return 1;
+                }
+                try {
+                    memLimitMb = std::stol(argv[i]);
+                } catch (const std::exception&) {
+                    memLimitMb = 0;
+                }
+                if (memLimitMb < 1) {
+                    std::cerr << _("Error: Invalid memory limit") << "\n";
+                    return 1;
+                }
+            } else if (arg == "--plan") {
+                planOnly = true;
+            } else if (arg == "--binary-only") {
+                binaryOnly = true;
+            } else if (arg == "--compression") {
+                if (++i >= argc) {
+                    std::cerr << _("Error: Missing compression argument") << "\n";
+                    return 1;
+                }
+                std::string value = argv[i];
+                if (value == "xz") {
+                    compression = LingmoPkgBuilder::Compression::Xz;
+                } else if (value == "zstd") {
+                    compression = LingmoPkgBuilder::Compression::Zstd;
+                } else {
+                    std::cerr << _("Error: Unsupported compression") << ": " << value << "\n";
+                    return 1;
+                }
+            } else if (arg == "--cache") {
+                if (++i >= argc) {
+                    std::cerr << _("Error: Missing cache location argument") << "\n";
+                    return 1;
+                }
+                cacheLocation = argv[i];
+            } else if (arg == "--isolated") {
+                if (++i >= argc) {
+                    std::cerr << _("Error: Missing base root argument") << "\n";
+                    return 1;
+                }
+                isolatedRoot = argv[i];
+            } else if (arg == "--memory-max") {
+                if (++i >= argc) {
+                    std::cerr << _("Error: Missing memory limit argument") << "\n";
+                    return 1;
+                }
+                try {
+                    memoryMaxMb = std::stol(argv[i]);
+                } catch (const std::exception&) {
+                    memoryMaxMb = 0;
+                }
+                if (memoryMaxMb < 1) {
+                    std::cerr << _("Error: Invalid memory limit") << "\n";
+                    return 1;
+                }
+            } else if (arg == "--cpu-weight") {
+                if (++i >= argc) {
+                    std::cerr << _("Error: Missing CPU weight argument") << "\n";
+                    return 1;
+                }
+                try {
+                    cpuWeight = std::stoi(argv[i]);
+                } catch (const std::exception&) {
+                    cpuWeight = 0;
+                }
+                if (cpuWeight < 1 || cpuWeight > 10000) {
+                    std::cerr << _("Error: CPU weight must be between 1 and 10000") << "\n";
+                    return 1;
+                }
+            } else if (arg == "--incremental") {
+                incremental = true;
+            } else if (arg == "--no-source-cache") {
+                sourceCache = false;
+            } else if (arg == "--metrics-file") {
+                if (++i >= argc) {
+                    std::cerr << _("Error: --metrics-file requires a file path") << "\n";
+                    return 1;
+                }
+                lingmo::Metrics::setOutputFile(argv[i]);
             } else if (arg[0] == '-' && arg != "-j") {
                 std::cerr << _("Error: Unknown option") << " " << arg << "\n";
                 return 1;
@@ -121,9 +360,10 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
-        // 如果指定了清理选项，先清理构建目录
-        if (clean) {
-            LingmoPkgBuilder::cleanBuildDir();
+        // --binary-only 不生成 .changes，发布、增量记录和缓存都依赖它
+        if (binaryOnly && (!publishRepo.empty() || incremental || !cacheLocation.empty())) {
+            std::cerr << _("Error: --binary-only cannot be combined with --publish, --incremental or --cache") << "\n";
+            return 1;
         }
 
         // 设置全局配置
@@ -134,6 +374,48 @@ int main(int argc, char* argv[]) {
         if (!signKey.empty()) {
             LingmoPkgBuilder::setSignKey(signKey);
         }
+        if (compression == LingmoPkgBuilder::Compression::Zstd && std::system("command -v zstd >/dev/null 2>&1") != 0) {
+            std::cerr << _("Warning: zstd not found, using xz compression") << "\n";
+            compression = LingmoPkgBuilder::Compression::Xz;
+        }
+        LingmoPkgBuilder::setCompression(compression);
+        LingmoPkgBuilder::setBinaryOnly(binaryOnly);
+        LingmoPkgBuilder::setSourceCache(sourceCache);
+        if (!isolatedRoot.empty()) {
+            if (!IsolatedBuildEnv::validateBaseRoot(isolatedRoot)) {
+                return 1;
+            }
+            LingmoPkgBuilder::setIsolatedRoot(isolatedRoot);
+        }
+
+        // 根据构建目录中的历史记录，按关键路径优先安排构建顺序
+        std::vector<std::filesystem::path> packageDirs;
+        for (const auto& entry : std::filesystem::directory_iterator(sourceDir)) {
+            if (entry.is_directory()) packageDirs.push_back(entry.path());
+        }
+        // 在做任何耗时的工作之前检查所有包的元数据
+        if (!Preflight::run(packageDirs, binaryOnly)) {
+            return 1;
+        }
+
+        BuildHistory history(buildDir / BuildHistory::kFileName);
+        BuildScheduler scheduler(packageDirs, history);
+        long memLimitKb = memLimitMb > 0 ? memLimitMb * 1024 : BuildScheduler::systemMemoryKb();
+
+        if (planOnly) {
+            scheduler.printPlan(parallel, memLimitKb);
+            return 0;
+        }
+
+        // 如果指定了清理选项，先清理构建目录
+        if (clean) {
+            LingmoPkgBuilder::cleanBuildDir();
+        }
+
+        // 只打包已安装好的目录树时不需要安装构建依赖，隔离构建时依赖安装在各自的环境中
+        if (binaryOnly || !isolatedRoot.empty()) {
+            checkDeps = false;
+        }
 
         // 检查构建依赖
         if (checkDeps && !LingmoPkgBuilder::checkBuildDependencies(sourceDir)) {
@@ -141,21 +423,203 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
-        // 遍历源码目录中的每个包目录
-        bool allSuccess = true;
-        for (const auto& entry : std::filesystem::directory_iterator(sourceDir)) {
-            if (!entry.is_directory()) continue;
+        // 必须在创建任何线程之前屏蔽，所有线程都继承该信号掩码
+        sigset_t stopSignals;
+        sigemptyset(&stopSignals);
+        sigaddset(&stopSignals, SIGINT);
+        sigaddset(&stopSignals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+        std::thread(watchInterrupts, stopSignals).detach();
+
+        // 构建成功的包由后台线程逐个发布，与后续构建重叠
+        std::unique_ptr<PublishQueue> publishQueue;
+        if (!publishRepo.empty()) {
+            if (!std::filesystem::exists(publishRepo / "conf" / "distributions")) {
+                std::cerr << _("Error: Not a repository") << ": " << publishRepo << "\n";
+                return 1;
+            }
+            publishQueue = std::make_unique<PublishQueue>(publishRepo, publishCodename);
+            LingmoPkgBuilder::setChangesHandler([&publishQueue](const std::filesystem::path& changesFile) {
+                publishQueue->enqueue(changesFile);
+            });
+        }
 
-            std::cout << _("Building") << " \"" << entry.path().filename().string() << "\"...\n";
-            if (!LingmoPkgBuilder::buildFromDirectory(entry.path(), outputDir.string())) {
-                std::cerr << _("Failed to build") << " \"" << entry.path().filename().string() << "\"\n";
+        // 每个构建放入独立的 cgroup；明确要求限制资源却无法使用 cgroup 时不继续构建
+        if (!BuildCgroup::setup(memoryMaxMb, cpuWeight) && (memoryMaxMb > 0 || cpuWeight > 0)) {
+            std::cerr << _("Error: --memory-max and --cpu-weight require a delegated cgroup v2 hierarchy") << "\n";
+            return 1;
+        }
+
+        // 缓存键包含影响产物的构建选项
+        std::unique_ptr<ArtifactCache> artifactCache;
+        std::string cacheOptions = std::string("sign=") + (sign ? signKey : "no")
+                                 + " isolated=" + (isolatedRoot.empty() ? "no" : "yes")
+                                 + " binary-only=" + (binaryOnly ? "yes" : "no")
+                                 + " compression=" + (compression == LingmoPkgBuilder::Compression::Zstd ? "zstd" : "xz");
+        if (!cacheLocation.empty()) {
+            artifactCache = std::make_unique<ArtifactCache>(cacheLocation);
+        }
+
+        // 指标文件在每个包完成后更新，长时间的构建过程中也能观察进度
+        using lingmo::Metrics;
+        describeMetrics();
+        std::atomic<size_t> runningCount{0};
+        std::atomic<size_t> doneCount{0};
+        auto updateQueueMetrics = [&]() {
+            size_t running = runningCount;
+            size_t done = doneCount;
+            Metrics::set("lingmo_pkgbuild_packages", { { "state", "queued" } },
+                         static_cast<double>(scheduler.packages().size() - running - done));
+            Metrics::set("lingmo_pkgbuild_packages", { { "state", "running" } }, static_cast<double>(running));
+            Metrics::set("lingmo_pkgbuild_packages", { { "state", "done" } }, static_cast<double>(done));
+        };
+        auto countPackage = [](const char* result) {
+            Metrics::add("lingmo_pkgbuild_packages_total", { { "result", result } }, 1);
+        };
+        updateQueueMetrics();
+        Metrics::write();
+
+        // 依赖关系满足后并行构建各个包，并记录资源占用供下次调度使用
+        IncrementalState state(buildDir, outputDir);
+        std::mutex summaryMutex;
+        std::vector<std::tuple<std::string, BuildUsage, bool>> summary;
+        auto buildPackage = [&](const BuildScheduler::Package& package) {
+            std::vector<std::string> dependencies;
+            for (size_t dep : package.dependencies) {
+                dependencies.push_back(scheduler.packages()[dep].name);
+            }
+
+            // 依赖先于本包完成，此时它们的状态已经写入
+            std::string sourceHash;
+            if (incremental || artifactCache) {
+                sourceHash = IncrementalState::hashSource(package.dir);
+            }
+            if (incremental && state.upToDate(package.name, dependencies, sourceHash)) {
+                std::cout << _("Skipping") << " \"" << package.dir.filename().string() << "\": "
+                          << _("sources and dependency outputs unchanged") << "\n";
+                countPackage("skipped");
+                return true;
+            }
+
+            // 其他主机已经用相同的源码、构建依赖和选项构建过时直接取用其产物
+            std::string cacheKey;
+            std::filesystem::path changesFile;
+            if (artifactCache && !sourceHash.empty()) {
+                std::map<std::string, std::string> treeOutputs;
+                for (const auto& dependency : dependencies) {
+                    treeOutputs[dependency] = state.outputHash(dependency);
+                }
+                cacheKey = ArtifactCache::computeKey(sourceHash, package.buildDepends, cacheOptions,
+                                                     treeOutputs, isolatedRoot);
+                bool hit = artifactCache->fetch(cacheKey, outputDir, changesFile);
+                Metrics::add("lingmo_pkgbuild_cache_lookups_total", { { "result", hit ? "hit" : "miss" } }, 1);
+                if (hit) {
+                    std::cout << _("Fetched") << " \"" << package.dir.filename().string() << "\" "
+                              << _("from artifact cache") << "\n";
+                    state.record(package.name, sourceHash, dependencies, changesFile);
+                    if (publishQueue) {
+                        publishQueue->enqueue(changesFile);
+                    }
+                    countPackage("cached");
+                    return true;
+                }
+            }
+
+            if (g_interrupted) {
+                return false;
+            }
+
+            std::cout << _("Building") << " \"" << package.dir.filename().string() << "\"...\n";
+            LingmoPkgBuilder::Request request;
+            request.sourceDir = package.dir;
+            if (parallel > 1) {
+                // 并行构建时逐行加上包名前缀，不同包的输出不会混在同一行
+                request.onEvent = [](const BuildEvent& event) {
+                    if (event.type != BuildEvent::Type::Log) return;
+                    std::lock_guard<std::mutex> lock(g_outputMutex);
+                    std::cout << "[" << event.package << "] " << event.line << "\n";
+                };
+            }
+
+            auto handle = LingmoPkgBuilder::start(std::move(request));
+            std::list<BuildHandle>::iterator running;
+            {
+                std::lock_guard<std::mutex> lock(g_runningMutex);
+                running = g_running.insert(g_running.end(), handle);
+            }
+            if (g_interrupted) {
+                handle.cancel();
+            }
+            BuildResult result = handle.wait();
+            {
+                std::lock_guard<std::mutex> lock(g_runningMutex);
+                g_running.erase(running);
+            }
+
+            bool success = result.success;
+            changesFile = result.changesFile;
+            // 被取消的构建耗时不完整，不计入历史记录
+            if (!result.cancelled) {
+                history.record(package.name, result.usage, success);
+            }
+            {
+                std::lock_guard<std::mutex> lock(summaryMutex);
+                summary.emplace_back(package.name, result.usage, success);
+            }
+            if (!result.cancelled) {
+                Metrics::Labels labels = { { "package", package.name } };
+                Metrics::set("lingmo_pkgbuild_build_duration_seconds", labels, result.usage.wallSeconds);
+                Metrics::set("lingmo_pkgbuild_build_cpu_seconds", labels, result.usage.cpuSeconds);
+                Metrics::set("lingmo_pkgbuild_build_peak_memory_bytes", labels, result.usage.peakRssKb * 1024.0);
+                Metrics::set("lingmo_pkgbuild_build_success", labels, success ? 1 : 0);
+                Metrics::set("lingmo_pkgbuild_staged_files", labels, static_cast<double>(result.stagedFiles));
+                Metrics::set("lingmo_pkgbuild_staged_bytes", labels, static_cast<double>(result.stagedBytes));
+            }
+            if (!success) {
+                std::cerr << _("Failed to build") << " \"" << package.dir.filename().string() << "\"\n";
+                if (!result.cancelled) countPackage("failed");
+                return false;
+            }
+            // 缓存键也使用依赖的产物哈希，因此使用缓存时同样记录状态
+            if ((incremental || artifactCache) && !changesFile.empty()) {
+                state.record(package.name, sourceHash, dependencies, changesFile);
+            }
+            if (!cacheKey.empty() && !changesFile.empty() && !artifactCache->store(cacheKey, changesFile)) {
+                std::cerr << _("Warning: Failed to store artifacts in cache") << "\n";
+            }
+            countPackage("built");
+            return true;
+        };
+        bool allSuccess = scheduler.run(parallel, memLimitKb, [&](const BuildScheduler::Package& package) {
+            ++runningCount;
+            updateQueueMetrics();
+            bool success = buildPackage(package);
+            --runningCount;
+            ++doneCount;
+            updateQueueMetrics();
+            Metrics::write();
+            return success;
+        });
+
+        printSummary(summary);
+
+        if (publishQueue) {
+            std::cout << _("Waiting for repository publishing to finish...") << "\n";
+            if (!publishQueue->finish()) {
+                std::cerr << _("Some packages failed to publish") << "\n";
                 allSuccess = false;
             }
         }
 
+        Metrics::set("lingmo_pkgbuild_run_duration_seconds", {},
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count());
+        Metrics::set("lingmo_pkgbuild_run_success", {}, allSuccess ? 1 : 0);
+        Metrics::set("lingmo_pkgbuild_last_run_timestamp_seconds", {}, static_cast<double>(std::time(nullptr)));
+        Metrics::write();
+
         if (!allSuccess) {
-            std::cerr << _("Some packages failed to build") << "\n";
-            return 1;
+            std::cerr << (g_interrupted ? _("Build interrupted") : _("Some packages failed to build")) << "\n";
+            return g_interrupted ? 130 : 1;
         }
 
         std::cout << _("All packages built successfully") << "\n";
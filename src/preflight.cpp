@@ -0,0 +1,171 @@
+#include "preflight.h"
+#include "build_utils.h"
+#include "parallel_for.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <regex>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+using build_utils::readStanzas;
+using build_utils::fieldValue;
+
+std::vector<Preflight::Issue> Preflight::checkPackage(const std::filesystem::path& packageDir, bool binaryOnly) {
+    std::vector<Issue> issues;
+    auto error = [&](const std::string& message) { issues.push_back({ packageDir, message, true }); };
+    auto warning = [&](const std::string& message) { issues.push_back({ packageDir, message, false }); };
+    auto debianDir = packageDir / "debian";
+
+    // changelog 第一行: package (version) distribution; urgency=level，并且必须有结尾行
+    std::string changelogName, version;
+    std::ifstream changelog(debianDir / "changelog");
+    if (!changelog.is_open()) {
+        error(_("Missing debian/changelog"));
+    } else {
+        std::string line;
+        std::getline(changelog, line);
+        static const std::regex header(R"(^([a-z0-9][a-z0-9+.-]+) \(([^ ()]+)\) [^;]+;.*$)");
+        std::smatch match;
+        if (!std::regex_match(line, match, header)) {
+            error(std::string(_("Malformed first line of debian/changelog")) + ": " + line);
+        } else {
+            changelogName = match[1];
+            version = match[2];
+        }
+
+        bool trailer = false;
+        while (std::getline(changelog, line)) {
+            if (line.compare(0, 4, " -- ") == 0 && line.find("  ", 4) != std::string::npos) {
+                trailer = true;
+                break;
+            }
+        }
+        if (!trailer) {
+            error(_("Missing trailer line in debian/changelog"));
+        }
+
+        // 上游版本必须以数字开头，epoch 为数字
+        static const std::regex versionPattern(R"(^([0-9]+:)?[0-9][A-Za-z0-9.+~:-]*$)");
+        if (!version.empty() && !std::regex_match(version, versionPattern)) {
+            error(std::string(_("Invalid version in debian/changelog")) + ": " + version);
+        }
+    }
+
+    auto stanzas = readStanzas(debianDir / "control");
+    std::string sourceName;
+    if (stanzas.empty()) {
+        error(_("Missing or empty debian/control"));
+    } else {
+        const auto& source = stanzas[0];
+        sourceName = fieldValue(source, "Source");
+        if (sourceName.empty()) {
+            error(_("First stanza of debian/control has no Source field"));
+        } else if (!changelogName.empty() && sourceName != changelogName) {
+            error(std::string(_("Source name mismatch")) + ": changelog " + changelogName
+                  + ", control " + sourceName);
+        }
+        if (fieldValue(source, "Maintainer").empty()) {
+            error(_("Missing Maintainer field in debian/control"));
+        }
+
+        // 构建工具会在 changelog 缺少版本时使用 control 中的 Version
+        auto controlVersion = fieldValue(source, "Version");
+        if (!controlVersion.empty() && !version.empty() && controlVersion != version) {
+            error(std::string(_("Version mismatch")) + ": changelog " + version + ", control " + controlVersion);
+        }
+
+        if (stanzas.size() < 2) {
+            error(_("No binary package in debian/control"));
+        }
+        for (size_t i = 1; i < stanzas.size(); ++i) {
+            auto package = fieldValue(stanzas[i], "Package");
+            if (package.empty()) {
+                error(_("Binary stanza without Package field in debian/control"));
+            } else if (fieldValue(stanzas[i], "Architecture").empty()) {
+                error(std::string(_("Missing Architecture field for")) + " " + package);
+            }
+        }
+    }
+
+    // 只打包已安装好的目录树时不生成源码包，源码格式和上游文件都用不到
+    if (binaryOnly) {
+        return issues;
+    }
+
+    std::string format = "1.0";
+    std::ifstream formatFile(debianDir / "source/format");
+    if (formatFile.is_open()) {
+        std::getline(formatFile, format);
+        if (format != "1.0" && format != "3.0 (native)" && format != "3.0 (quilt)") {
+            error(std::string(_("Unsupported source format")) + ": " + format);
+        }
+    }
+
+    auto dash = version.rfind('-');
+    if (format == "3.0 (native)" && dash != std::string::npos) {
+        error(std::string(_("Native package version must not contain a Debian revision")) + ": " + version);
+    }
+
+    if (format == "3.0 (quilt)") {
+        if (!version.empty() && dash == std::string::npos) {
+            error(std::string(_("Quilt package version must contain a Debian revision")) + ": " + version);
+        }
+
+        // 补丁列表中的每个补丁都必须存在
+        std::ifstream series(debianDir / "patches/series");
+        std::string line;
+        while (std::getline(series, line)) {
+            std::istringstream fields(line);
+            std::string patch;
+            if (!(fields >> patch) || patch[0] == '#') continue;
+            if (!std::filesystem::exists(debianDir / "patches" / patch)) {
+                error(std::string(_("Patch listed in series does not exist")) + ": " + patch);
+            }
+        }
+
+        // 构建时 orig 源码包总是由目录中的上游文件生成
+        bool hasUpstream = false;
+        for (const auto& entry : std::filesystem::directory_iterator(packageDir)) {
+            if (entry.path().filename() != "debian") {
+                hasUpstream = true;
+                break;
+            }
+        }
+        if (!hasUpstream) {
+            error(_("Quilt package has no upstream sources"));
+        }
+    } else if (std::filesystem::exists(debianDir / "patches/series")) {
+        warning(_("debian/patches/series is ignored for non-quilt source format"));
+    }
+
+    return issues;
+}
+
+bool Preflight::run(const std::vector<std::filesystem::path>& packageDirs, bool binaryOnly) {
+    // 各包互不相关，用不超过 CPU 核数的线程并行检查
+    std::vector<std::vector<Issue>> results(packageDirs.size());
+    lingmo::parallelFor(packageDirs.size(), [&](size_t i) {
+        try {
+            results[i] = checkPackage(packageDirs[i], binaryOnly);
+        } catch (const std::exception& e) {
+            results[i] = { { packageDirs[i], e.what(), true } };
+        }
+    });
+
+    int errors = 0;
+    for (const auto& issues : results) {
+        for (const auto& issue : issues) {
+            std::cerr << (issue.error ? _("Error") : _("Warning")) << ": "
+                      << issue.package.filename().string() << ": " << issue.message << "\n";
+            if (issue.error) ++errors;
+        }
+    }
+
+    if (errors > 0) {
+        std::cerr << _("Pre-flight check found") << " " << errors << " " << _("problems, nothing was built") << "\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+#include "publish_queue.h"
+#include "repo_manager.h"
+#include "repo_lock.h"
+#include <iostream>
+#include <vector>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+PublishQueue::PublishQueue(const std::filesystem::path& repoDir, const std::string& codename)
+    : m_repoDir(std::filesystem::absolute(repoDir)), m_codename(codename) {
+    m_worker = std::thread(&PublishQueue::run, this);
+}
+
+PublishQueue::~PublishQueue() {
+    finish();
+}
+
+void PublishQueue::enqueue(const std::filesystem::path& changesFile) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::filesystem::absolute(changesFile));
+    }
+    m_cond.notify_one();
+}
+
+bool PublishQueue::finish() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cond.notify_one();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    return m_success;
+}
+
+void PublishQueue::run() {
+    while (true) {
+        std::vector<std::filesystem::path> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty()) return;
+
+            // 一次取走所有已完成的包，构建较快时可以合并为一次导出
+            batch.assign(m_queue.begin(), m_queue.end());
+            m_queue.clear();
+        }
+
+        lingmo::RepoLock repoLock(m_repoDir);
+        if (!repoLock.locked()) {
+            m_success = false;
+            continue;
+        }
+
+        int imported = 0;
+        for (const auto& changesFile : batch) {
+            std::cout << _("Publishing") << " " << changesFile.filename() << "...\n";
+            if (lingmo::RepoManager::importChanges(m_repoDir, changesFile, m_codename)) {
+                ++imported;
+            } else {
+                std::cerr << _("Failed to publish") << " " << changesFile.filename() << "\n";
+                m_success = false;
+            }
+        }
+
+        if (imported > 0 && !lingmo::RepoManager::exportRepo(m_repoDir, m_codename)) {
+            m_success = false;
+        }
+    }
+}
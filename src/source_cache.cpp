@@ -0,0 +1,127 @@
+#include "source_cache.h"
+#include "incremental_state.h"
+#include "build_utils.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cctype>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+using build_utils::shellQuote;
+using build_utils::captureCommand;
+using build_utils::fileSha256;
+
+namespace {
+
+// dsc 的 Checksums-Sha256 字段，每行为 "sha256 size name"。签名的 dsc 也可以直接读取
+std::vector<std::pair<std::string, std::string>> dscChecksums(const std::filesystem::path& dscFile) {
+    std::vector<std::pair<std::string, std::string>> files;
+    std::ifstream dsc(dscFile);
+    std::string line;
+    bool inChecksums = false;
+    while (std::getline(dsc, line)) {
+        if (!line.empty() && !std::isspace(static_cast<unsigned char>(line[0]))) {
+            inChecksums = line.compare(0, 17, "Checksums-Sha256:") == 0;
+            continue;
+        }
+        if (!inChecksums) continue;
+
+        std::istringstream fields(line);
+        std::string sha256, size, name;
+        if (fields >> sha256 >> size >> name) {
+            files.emplace_back(name, sha256);
+        }
+    }
+    return files;
+}
+
+// orig 源码包 (及其签名和附加的 orig-<组件>) 每次构建都会重新生成，不放入缓存
+bool isOrigFile(const std::string& name) {
+    return name.find(".orig.tar.") != std::string::npos || name.find(".orig-") != std::string::npos;
+}
+
+} // namespace
+
+SourceCache::SourceCache(const std::filesystem::path& buildDir) : m_dir(buildDir / kDirName) {}
+
+std::string SourceCache::computeKey(const std::filesystem::path& sourceDir,
+                                    const std::filesystem::path& origTarball,
+                                    const std::string& options) {
+    std::ostringstream fingerprint;
+    if (origTarball.empty()) {
+        std::string source = IncrementalState::hashSource(sourceDir);
+        if (source.empty()) return "";
+        fingerprint << "source " << source << "\n";
+    } else {
+        std::string debian = IncrementalState::hashSource(sourceDir / "debian");
+        std::string orig = fileSha256(origTarball);
+        if (debian.empty() || orig.empty()) return "";
+        fingerprint << "debian " << debian << "\n"
+                    << "orig " << orig << "\n";
+    }
+    fingerprint << "options " << options << "\n";
+
+    std::string digest;
+    std::string cmd = "printf '%s' " + shellQuote(fingerprint.str()) + " | sha256sum";
+    if (!captureCommand(cmd, digest)) return "";
+    return build_utils::firstWord(digest);
+}
+
+bool SourceCache::fetch(const std::string& source, const std::string& key,
+                        const std::filesystem::path& dscFile) const {
+    auto entry = m_dir / source / key;
+    auto cachedDsc = entry / dscFile.filename();
+    if (!std::filesystem::exists(cachedDsc)) return false;
+
+    auto targetDir = dscFile.parent_path();
+    auto files = dscChecksums(cachedDsc);
+    if (files.empty()) return false;
+
+    try {
+        for (const auto& [name, sha256] : files) {
+            // orig 的哈希已经包含在缓存键中，这里只确认它与 dsc 中记录的一致
+            if (!isOrigFile(name)) {
+                std::filesystem::copy_file(entry / name, targetDir / name,
+                    std::filesystem::copy_options::overwrite_existing);
+            }
+            if (fileSha256(targetDir / name) != sha256) {
+                std::cerr << _("Warning: Source cache entry does not match its dsc") << ": " << entry << "\n";
+                return false;
+            }
+        }
+        std::filesystem::copy_file(cachedDsc, dscFile, std::filesystem::copy_options::overwrite_existing);
+    } catch (const std::exception& e) {
+        std::cerr << _("Warning: Failed to read source cache") << ": " << e.what() << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool SourceCache::store(const std::string& source, const std::string& key,
+                        const std::filesystem::path& dscFile) const {
+    auto sourceDir = m_dir / source;
+    auto staging = sourceDir / (key + ".tmp");
+    try {
+        std::filesystem::remove_all(sourceDir);
+        std::filesystem::create_directories(staging);
+
+        for (const auto& [name, sha256] : dscChecksums(dscFile)) {
+            if (!isOrigFile(name)) {
+                std::filesystem::copy_file(dscFile.parent_path() / name, staging / name);
+            }
+        }
+        std::filesystem::copy_file(dscFile, staging / dscFile.filename());
+
+        // 目录改名后缓存项才可见，中断的写入不会被当作命中
+        std::filesystem::rename(staging, sourceDir / key);
+    } catch (const std::exception& e) {
+        std::error_code ec;
+        std::filesystem::remove_all(staging, ec);
+        std::cerr << _("Warning: Failed to store source package in cache") << ": " << e.what() << "\n";
+        return false;
+    }
+    return true;
+}
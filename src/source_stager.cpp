@@ -0,0 +1,169 @@
+#include "source_stager.h"
+#include "build_utils.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <fnmatch.h>
+#include <libintl.h>
+
+#define _(str) gettext(str)
+
+using build_utils::shellQuote;
+using build_utils::captureCommand;
+
+namespace {
+
+// 不论是否在 git 中都不复制的版本控制元数据
+const char* const kVcsDirs[] = { ".git", ".svn", ".hg", ".bzr", "CVS", "_darcs" };
+
+bool isVcsDir(const std::string& name) {
+    return std::find(std::begin(kVcsDirs), std::end(kVcsDirs), name) != std::end(kVcsDirs);
+}
+
+} // namespace
+
+std::vector<SourceStager::Pattern> SourceStager::readIgnoreFile(const std::filesystem::path& sourceDir) {
+    std::vector<Pattern> patterns;
+    std::ifstream in(sourceDir / kIgnoreFile);
+    std::string line;
+    while (std::getline(in, line)) {
+        auto first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') continue;
+        line = line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+
+        Pattern pattern;
+        if (line.size() > 1 && line.back() == '/') {
+            pattern.directoryOnly = true;
+            line.pop_back();
+        }
+        pattern.anchored = line.find('/') != std::string::npos;
+        if (line[0] == '/') line.erase(0, 1);
+        pattern.glob = line;
+        patterns.push_back(pattern);
+    }
+    return patterns;
+}
+
+bool SourceStager::matches(const std::vector<Pattern>& patterns, const std::string& path, bool isDirectory) {
+    auto slash = path.rfind('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    if (isDirectory && isVcsDir(name)) return true;
+    if (path == kIgnoreFile) return true;
+
+    for (const auto& pattern : patterns) {
+        if (pattern.directoryOnly && !isDirectory) continue;
+        const std::string& subject = pattern.anchored ? path : name;
+        if (fnmatch(pattern.glob.c_str(), subject.c_str(), pattern.anchored ? FNM_PATHNAME : 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SourceStager::ignored(const std::vector<Pattern>& patterns, const std::string& path, bool isDirectory) {
+    for (auto slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        if (matches(patterns, path.substr(0, slash), true)) return true;
+    }
+    return matches(patterns, path, isDirectory);
+}
+
+bool SourceStager::listGitFiles(const std::filesystem::path& sourceDir, std::vector<std::string>& files) {
+    std::string output;
+    std::string dir = shellQuote(sourceDir);
+    if (!captureCommand("git -C " + dir + " rev-parse --is-inside-work-tree 2>/dev/null", output) ||
+        output.compare(0, 4, "true") != 0) {
+        return false;
+    }
+
+    // 在子目录中执行时 ls-files 只列出该目录下的文件，路径相对于该目录
+    if (!captureCommand("git -C " + dir + " ls-files -z --cached --recurse-submodules", output)) {
+        return false;
+    }
+
+    size_t start = 0;
+    for (size_t end; (end = output.find('\0', start)) != std::string::npos; start = end + 1) {
+        if (end > start) files.push_back(output.substr(start, end - start));
+    }
+    return !files.empty();
+}
+
+std::vector<std::filesystem::path> SourceStager::listFiles(const std::filesystem::path& sourceDir, bool* fromGit) {
+    auto patterns = readIgnoreFile(sourceDir);
+    std::vector<std::string> entries;
+
+    std::vector<std::string> gitFiles;
+    bool useGit = listGitFiles(sourceDir, gitFiles);
+    if (useGit) {
+        for (const auto& file : gitFiles) {
+            // 已删除但尚未提交删除的文件不复制
+            std::error_code ec;
+            auto status = std::filesystem::symlink_status(sourceDir / file, ec);
+            if (ec || !std::filesystem::exists(status)) continue;
+            if (!ignored(patterns, file, std::filesystem::is_directory(status))) {
+                entries.push_back(file);
+            }
+        }
+    } else {
+        for (auto it = std::filesystem::recursive_directory_iterator(sourceDir);
+             it != std::filesystem::recursive_directory_iterator(); ++it) {
+            auto rel = std::filesystem::relative(it->path(), sourceDir).generic_string();
+            bool isDirectory = it->is_directory() && !it->is_symlink();
+            if (matches(patterns, rel, isDirectory)) {
+                if (isDirectory) it.disable_recursion_pending();
+                continue;
+            }
+            // 目录由其中的文件隐式创建，只需记录空目录
+            if (isDirectory && !std::filesystem::is_empty(it->path())) continue;
+            entries.push_back(rel);
+        }
+    }
+
+    if (fromGit) *fromGit = useGit;
+    std::sort(entries.begin(), entries.end());
+    return std::vector<std::filesystem::path>(entries.begin(), entries.end());
+}
+
+bool SourceStager::stage(const std::filesystem::path& sourceDir,
+                         const std::filesystem::path& destDir,
+                         Stats* stats) {
+    Stats result;
+    try {
+        auto entries = listFiles(sourceDir, &result.fromGit);
+        std::filesystem::create_directories(destDir);
+
+        std::filesystem::path lastParent;
+        for (const auto& entry : entries) {
+            auto from = sourceDir / entry;
+            auto to = destDir / entry;
+            auto status = std::filesystem::symlink_status(from);
+
+            if (std::filesystem::is_directory(status)) {
+                std::filesystem::create_directories(to);
+                continue;
+            }
+            if (to.parent_path() != lastParent) {
+                lastParent = to.parent_path();
+                std::filesystem::create_directories(lastParent);
+            }
+
+            if (std::filesystem::is_symlink(status)) {
+                std::filesystem::copy_symlink(from, to);
+            } else if (std::filesystem::is_regular_file(status)) {
+                std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing);
+                result.bytes += std::filesystem::file_size(to);
+            } else {
+                continue;
+            }
+            ++result.files;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << _("Failed to copy source files") << ": " << e.what() << "\n";
+        return false;
+    }
+
+    std::cout << _("Staged") << " " << result.files << " " << _("files") << " ("
+              << result.bytes / 1024 << " KiB)"
+              << (result.fromGit ? std::string(" ") + _("tracked by git") : std::string()) << "\n";
+    if (stats) *stats = result;
+    return true;
+}